@@ -1,14 +1,104 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
 #include <vector>
 
+#include "mesh.h"
+
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tinyobjloader/tiny_obj_loader.h"
 
 #include <glm/glm.hpp>
 
+// A point inside a face, at barycentric coordinates (1 - u - v, u, v) relative to the face corners. Faces are
+// numbered in order of appearance across all shapes.
+struct SurfacePoint {
+    uint32_t face;
+    float u, v;
+};
+
 class DistanceAlgorithm {
    public:
-    virtual void load(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes) = 0;
+    DistanceAlgorithm() : mesh(std::make_shared<const Mesh>()) {}
+    virtual ~DistanceAlgorithm() {}
+
+    // Shares the mesh with whoever else holds it; derived data the algorithm needs is built into the mesh on demand.
+    void load(std::shared_ptr<const Mesh> loaded) {
+        mesh = std::move(loaded);
+        prepare();
+    }
+
+    void load(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes) {
+        load(Mesh::fromObj(attrib, shapes));
+    }
+
     virtual std::vector<float> propagate(int src) = 0;
-};
\ No newline at end of file
+    virtual std::vector<float> propagate(const SurfacePoint& src) = 0;
+
+    // Writes the distances from src into out, which holds one float per vertex. Algorithms that can search without
+    // allocating per call override this; the default copies the result of propagate().
+    virtual void propagateInto(int src, float* out) {
+        std::vector<float> distances = propagate(src);
+        std::copy(distances.begin(), distances.end(), out);
+    }
+
+    // Moves the vertices of the loaded mesh; the topology stays the same. The mesh is replaced rather than modified,
+    // so other holders of the old one are unaffected; once the algorithm is the only holder, its edge graph is reused
+    // in place from frame to frame.
+    virtual void updatePositions(const float* positions) { mesh = Mesh::withPositions(std::move(mesh), positions); }
+
+    // Appends the vertices of the shortest path from the last propagated source to target, source side first.
+    // Returns false if the algorithm does not track paths or target is unreachable.
+    virtual bool appendPath(uint32_t target, std::vector<uint32_t>& path) const { return false; }
+
+    std::vector<uint32_t> path(uint32_t target) const {
+        std::vector<uint32_t> result;
+        appendPath(target, result);
+        return result;
+    }
+
+    // Concatenates the paths to count targets; path i is vertices[offsets[i], offsets[i + 1]).
+    void paths(const uint32_t* targets, size_t count, std::vector<uint32_t>& offsets,
+               std::vector<uint32_t>& vertices) const {
+        offsets.resize(count + 1);
+        offsets[0] = 0;
+        vertices.clear();
+        for (size_t i = 0; i < count; ++i) {
+            appendPath(targets[i], vertices);
+            offsets[i + 1] = vertices.size();
+        }
+    }
+
+    const std::shared_ptr<const Mesh>& getMesh() const { return mesh; }
+    const std::vector<glm::vec3>& getVertices() const { return mesh->positions(); }
+
+    glm::vec3 position(const SurfacePoint& p) const {
+        const std::vector<glm::vec3>& vertices = mesh->positions();
+        const uint32_t* f = &mesh->indices()[3 * p.face];
+        return (1.f - p.u - p.v) * vertices[f[0]] + p.u * vertices[f[1]] + p.v * vertices[f[2]];
+    }
+
+    // Linearly interpolates a per-vertex field at count surface points. A point on a face with an unreached corner
+    // (float max) is unreached as well.
+    void interpolate(const std::vector<float>& field, const SurfacePoint* points, size_t count, float* out) const {
+        const float kInf = std::numeric_limits<float>::max();
+        const float* d = field.data();
+        const uint32_t* f = mesh->indices().data();
+        for (size_t i = 0; i < count; ++i) {
+            const uint32_t* c = f + 3 * points[i].face;
+            float a = d[c[0]], b = d[c[1]], e = d[c[2]];
+            float u = points[i].u, v = points[i].v;
+            float value = (1.f - u - v) * a + u * b + v * e;
+            out[i] = a == kInf || b == kInf || e == kInf ? kInf : value;
+        }
+    }
+
+   protected:
+    // Called by load() once the mesh is set.
+    virtual void prepare() = 0;
+
+    std::shared_ptr<const Mesh> mesh;
+};
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// 32-byte node; children of an inner node are stored next to each other at leftFirst and leftFirst + 1.
+struct BvhNode {
+    float bmin[3];
+    uint32_t leftFirst;  // first child for inner nodes, first entry of Bvh::faces() for leaves
+    float bmax[3];
+    uint32_t count;  // number of triangles in a leaf, 0 for inner nodes
+};
+
+struct RayHit {
+    uint32_t face;
+    float t;
+    float u, v;  // barycentric coordinates of the hit relative to corners 1 and 2
+};
+
+// Bounding volume hierarchy over an indexed triangle mesh, built with the binned surface area heuristic. The
+// positions and indices are not copied and must outlive the Bvh.
+class Bvh {
+   public:
+    Bvh() : positions(nullptr), indices(nullptr), nodes(), faceIds(), centroids() {}
+
+    void build(const float* positions, const uint32_t* indices, size_t numFaces) {
+        this->positions = positions;
+        this->indices = indices;
+        nodes.clear();
+        faceIds.resize(numFaces);
+        centroids.resize(numFaces);
+        for (size_t f = 0; f < numFaces; ++f) {
+            faceIds[f] = f;
+            centroids[f] = (vertex(f, 0) + vertex(f, 1) + vertex(f, 2)) / 3.f;
+        }
+        if (numFaces == 0) return;
+
+        nodes.reserve(2 * numFaces);
+        nodes.push_back(BvhNode());
+        nodes[0].leftFirst = 0;
+        nodes[0].count = numFaces;
+        updateBounds(0);
+
+        // node, depth; nodes at kMaxDepth stay leaves however many triangles they hold, which bounds the traversal
+        // stack in intersect()
+        std::vector<std::pair<uint32_t, int>> stack(1, std::make_pair(0u, 0));
+        while (!stack.empty()) {
+            uint32_t n = stack.back().first;
+            int depth = stack.back().second;
+            stack.pop_back();
+            if (depth < kMaxDepth && subdivide(n)) {
+                stack.push_back(std::make_pair(nodes[n].leftFirst, depth + 1));
+                stack.push_back(std::make_pair(nodes[n].leftFirst + 1, depth + 1));
+            }
+        }
+        nodes.shrink_to_fit();
+        centroids.clear();
+        centroids.shrink_to_fit();
+    }
+
+    // Finds the closest triangle hit along origin + t * dir with t in (0, hit.t), returns false on a miss.
+    bool intersect(const glm::vec3& origin, const glm::vec3& dir, RayHit& hit,
+                   float tMax = std::numeric_limits<float>::max()) const {
+        hit.t = tMax;
+        if (nodes.empty()) return false;
+
+        glm::vec3 invDir(1.f / dir[0], 1.f / dir[1], 1.f / dir[2]);
+        bool found = false;
+        uint32_t stack[kMaxDepth + 1];  // every level leaves at most one far child behind
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const BvhNode& node = nodes[stack[--top]];
+            if (slab(node, origin, invDir, hit.t) == std::numeric_limits<float>::max()) continue;
+
+            if (node.count > 0) {
+                for (uint32_t i = 0; i < node.count; ++i) {
+                    found |= intersectTriangle(faceIds[node.leftFirst + i], origin, dir, hit);
+                }
+                continue;
+            }
+
+            // visit the nearer child first
+            uint32_t nearChild = node.leftFirst, farChild = node.leftFirst + 1;
+            float tNear = slab(nodes[nearChild], origin, invDir, hit.t);
+            float tFar = slab(nodes[farChild], origin, invDir, hit.t);
+            if (tNear > tFar) {
+                std::swap(nearChild, farChild);
+                std::swap(tNear, tFar);
+            }
+            if (tFar != std::numeric_limits<float>::max()) stack[top++] = farChild;
+            if (tNear != std::numeric_limits<float>::max()) stack[top++] = nearChild;
+        }
+        return found;
+    }
+
+    const std::vector<BvhNode>& getNodes() const { return nodes; }
+    const std::vector<uint32_t>& faces() const { return faceIds; }
+
+   private:
+    static const int kBins = 12;
+    static const uint32_t kMaxLeafSize = 4;
+    static const int kMaxDepth = 64;
+
+    struct Aabb {
+        glm::vec3 bmin, bmax;
+        Aabb() : bmin(std::numeric_limits<float>::max()), bmax(-std::numeric_limits<float>::max()) {}
+        void grow(const glm::vec3& p) {
+            bmin = glm::min(bmin, p);
+            bmax = glm::max(bmax, p);
+        }
+        void grow(const Aabb& b) {
+            bmin = glm::min(bmin, b.bmin);
+            bmax = glm::max(bmax, b.bmax);
+        }
+        float area() const {
+            glm::vec3 e = bmax - bmin;
+            return e[0] < 0 ? 0.f : e[0] * e[1] + e[1] * e[2] + e[2] * e[0];
+        }
+    };
+
+    glm::vec3 vertex(size_t f, int corner) const {
+        const float* p = positions + 3 * indices[3 * f + corner];
+        return glm::vec3(p[0], p[1], p[2]);
+    }
+
+    void updateBounds(uint32_t n) {
+        BvhNode& node = nodes[n];
+        Aabb box;
+        for (uint32_t i = 0; i < node.count; ++i) {
+            uint32_t f = faceIds[node.leftFirst + i];
+            for (int c = 0; c < 3; ++c) box.grow(vertex(f, c));
+        }
+        for (int c = 0; c < 3; ++c) {
+            node.bmin[c] = box.bmin[c];
+            node.bmax[c] = box.bmax[c];
+        }
+    }
+
+    // Splits a node at the best binned SAH plane; returns false if it stays a leaf.
+    bool subdivide(uint32_t n) {
+        uint32_t first = nodes[n].leftFirst, count = nodes[n].count;
+        if (count <= kMaxLeafSize) return false;
+
+        Aabb centroidBounds;
+        for (uint32_t i = 0; i < count; ++i) centroidBounds.grow(centroids[faceIds[first + i]]);
+
+        int bestAxis = -1, bestSplit = 0;
+        float bestCost = std::numeric_limits<float>::max();
+        for (int axis = 0; axis < 3; ++axis) {
+            float lo = centroidBounds.bmin[axis], hi = centroidBounds.bmax[axis];
+            if (hi <= lo) continue;
+
+            Aabb bins[kBins];
+            uint32_t binCounts[kBins] = {};
+            float scale = kBins / (hi - lo);
+            for (uint32_t i = 0; i < count; ++i) {
+                uint32_t f = faceIds[first + i];
+                int b = std::min(kBins - 1, int((centroids[f][axis] - lo) * scale));
+                ++binCounts[b];
+                for (int c = 0; c < 3; ++c) bins[b].grow(vertex(f, c));
+            }
+
+            // sweep from the right to get the area of every right-hand partition
+            float rightArea[kBins];
+            uint32_t rightCount[kBins];
+            Aabb box;
+            uint32_t sum = 0;
+            for (int b = kBins - 1; b > 0; --b) {
+                box.grow(bins[b]);
+                sum += binCounts[b];
+                rightArea[b] = box.area();
+                rightCount[b] = sum;
+            }
+
+            box = Aabb();
+            sum = 0;
+            for (int b = 0; b < kBins - 1; ++b) {
+                box.grow(bins[b]);
+                sum += binCounts[b];
+                float cost = sum * box.area() + rightCount[b + 1] * rightArea[b + 1];
+                if (sum > 0 && rightCount[b + 1] > 0 && cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b + 1;
+                }
+            }
+        }
+
+        const BvhNode& node = nodes[n];
+        Aabb nodeBox;
+        nodeBox.bmin = glm::vec3(node.bmin[0], node.bmin[1], node.bmin[2]);
+        nodeBox.bmax = glm::vec3(node.bmax[0], node.bmax[1], node.bmax[2]);
+        if (bestAxis < 0 || bestCost >= count * nodeBox.area()) return false;
+
+        float lo = centroidBounds.bmin[bestAxis];
+        float scale = kBins / (centroidBounds.bmax[bestAxis] - lo);
+        uint32_t* mid = std::partition(&faceIds[first], &faceIds[first] + count, [&](uint32_t f) {
+            return std::min(kBins - 1, int((centroids[f][bestAxis] - lo) * scale)) < bestSplit;
+        });
+        uint32_t leftCount = mid - &faceIds[first];
+
+        uint32_t left = nodes.size();
+        nodes.push_back(BvhNode());
+        nodes.push_back(BvhNode());
+        nodes[left].leftFirst = first;
+        nodes[left].count = leftCount;
+        nodes[left + 1].leftFirst = first + leftCount;
+        nodes[left + 1].count = count - leftCount;
+        nodes[n].leftFirst = left;
+        nodes[n].count = 0;
+        updateBounds(left);
+        updateBounds(left + 1);
+        return true;
+    }
+
+    // Returns the entry distance into the node's box, or float max if the ray misses it before tMax.
+    static float slab(const BvhNode& node, const glm::vec3& origin, const glm::vec3& invDir, float tMax) {
+        float t0 = 0.f, t1 = tMax;
+        for (int c = 0; c < 3; ++c) {
+            float tA = (node.bmin[c] - origin[c]) * invDir[c];
+            float tB = (node.bmax[c] - origin[c]) * invDir[c];
+            t0 = std::max(t0, std::min(tA, tB));
+            t1 = std::min(t1, std::max(tA, tB));
+        }
+        return t0 <= t1 ? t0 : std::numeric_limits<float>::max();
+    }
+
+    // Moeller-Trumbore. det is the triple product of dir, e1 and e2, so it is compared relative to their lengths: the
+    // test rejects rays within about a float epsilon of the plane of the triangle and degenerate triangles, at any
+    // scale of the mesh.
+    bool intersectTriangle(uint32_t f, const glm::vec3& origin, const glm::vec3& dir, RayHit& hit) const {
+        glm::vec3 v0 = vertex(f, 0);
+        glm::vec3 e1 = vertex(f, 1) - v0;
+        glm::vec3 e2 = vertex(f, 2) - v0;
+        glm::vec3 p = glm::cross(dir, e2);
+        float det = glm::dot(e1, p);
+        const float kEpsilon = 1e-7f;
+        float scale = glm::dot(dir, dir) * glm::dot(e1, e1) * glm::dot(e2, e2);
+        if (!(det * det > kEpsilon * kEpsilon * scale)) return false;
+
+        float invDet = 1.f / det;
+        glm::vec3 s = origin - v0;
+        float u = glm::dot(s, p) * invDet;
+        if (u < 0.f || u > 1.f) return false;
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(dir, q) * invDet;
+        if (v < 0.f || u + v > 1.f) return false;
+        float t = glm::dot(e2, q) * invDet;
+        if (t <= 0.f || t >= hit.t) return false;
+
+        hit.face = f;
+        hit.t = t;
+        hit.u = u;
+        hit.v = v;
+        return true;
+    }
+
+    const float* positions;
+    const uint32_t* indices;
+    std::vector<BvhNode> nodes;
+    std::vector<uint32_t> faceIds;
+    std::vector<glm::vec3> centroids;
+};
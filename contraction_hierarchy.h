@@ -0,0 +1,558 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "edge_graph.h"
+#include "parallel.h"
+
+// Contraction hierarchy (Geisberger et al. 2008) over a mesh edge graph for fast vertex-to-vertex distances.
+// Vertices are contracted one independent set at a time, cheapest first by edge difference; shortcuts keep the
+// distances between the remaining vertices. A query then only searches upwards in the order from both ends.
+//
+// Unlike road networks, surface meshes have separators of about sqrt(n) vertices, so the top of a full hierarchy is
+// close to a clique and upward searches would scan a good part of the graph there. Contraction therefore stops at a
+// core of at most coreSize vertices, whose pairwise distances are kept in a table: upward searches stop at the core,
+// and the best pair of core vertices they reached is looked up. This suits meshes of up to some 100k vertices;
+// contraction slows down a lot beyond that, as the core takes longer and longer to reach.
+//
+// Distances equal those of the edge graph up to float rounding, since shortcuts sum their edges in a different
+// order than a search from the source does. The hierarchy can be saved next to the mesh and mapped back.
+class ContractionHierarchy {
+   public:
+    // Per-query state, so that concurrent queries each use their own.
+    class Search {
+       public:
+        Search() : forward(), backward(), touched(), access(), heap() {}
+
+       private:
+        friend class ContractionHierarchy;
+        std::vector<float> forward, backward;
+        std::vector<uint32_t> touched, access[2];  // access: core vertices reached from either end
+        std::vector<std::pair<float, uint32_t>> heap;
+    };
+
+    ContractionHierarchy()
+        : numVertices(0),
+          numEdges(0),
+          numCore(0),
+          offsets(nullptr),
+          neighbors(nullptr),
+          weights(nullptr),
+          coreIndex(nullptr),
+          table(nullptr),
+          mapped(nullptr),
+          mappedSize(0),
+          storage(),
+          search() {}
+    ~ContractionHierarchy() { unmap(); }
+
+    // The table takes coreSize^2 floats.
+    void build(const EdgeGraph& graph, size_t coreSize = 2048) {
+        unmap();
+        size_t n = graph.size();
+        std::vector<std::vector<Arc>> up(n);
+        Contraction contraction(graph);
+        std::vector<uint32_t> core = contraction.run(coreSize, up);
+
+        storage.offsets.assign(n + 1, 0);
+        storage.neighbors.clear();
+        storage.weights.clear();
+        for (size_t v = 0; v < n; ++v) {
+            storage.offsets[v + 1] = storage.offsets[v] + up[v].size();
+            for (size_t i = 0; i < up[v].size(); ++i) {
+                storage.neighbors.push_back(up[v][i].first);
+                storage.weights.push_back(up[v][i].second);
+            }
+        }
+        storage.coreIndex.assign(n, uint32_t(kNotCore));
+        for (size_t i = 0; i < core.size(); ++i) storage.coreIndex[core[i]] = i;
+        storage.table.resize(core.size() * core.size());
+        contraction.coreDistances(core, storage.table.data());
+
+        numVertices = n;
+        numEdges = storage.neighbors.size();
+        numCore = core.size();
+        offsets = storage.offsets.data();
+        neighbors = storage.neighbors.data();
+        weights = storage.weights.data();
+        coreIndex = storage.coreIndex.data();
+        table = storage.table.data();
+    }
+
+    // Distance between s and t, or float max if they are not connected.
+    float distance(uint32_t s, uint32_t t, Search& state) const {
+        const float kInf = std::numeric_limits<float>::max();
+        if (state.forward.size() != numVertices) {
+            state.forward.assign(numVertices, kInf);
+            state.backward.assign(numVertices, kInf);
+        }
+        upwardSearch(s, state.forward, state.access[0], state);
+        upwardSearch(t, state.backward, state.access[1], state);
+
+        float best = kInf;
+        for (size_t i = 0; i < state.touched.size(); ++i) {
+            uint32_t v = state.touched[i];
+            if (state.forward[v] != kInf && state.backward[v] != kInf) {
+                best = std::min(best, state.forward[v] + state.backward[v]);
+            }
+        }
+        // access lists come in the order vertices were settled, by increasing distance
+        for (size_t i = 0; i < state.access[0].size(); ++i) {
+            uint32_t a = state.access[0][i];
+            const float* row = table + size_t(coreIndex[a]) * numCore;
+            for (size_t j = 0; j < state.access[1].size(); ++j) {
+                uint32_t b = state.access[1][j];
+                if (state.forward[a] + state.backward[b] >= best) break;
+                float between = row[coreIndex[b]];
+                if (between != kInf) best = std::min(best, state.forward[a] + between + state.backward[b]);
+            }
+        }
+
+        for (size_t i = 0; i < state.touched.size(); ++i) {
+            state.forward[state.touched[i]] = kInf;
+            state.backward[state.touched[i]] = kInf;
+        }
+        state.touched.clear();
+        state.access[0].clear();
+        state.access[1].clear();
+        return best;
+    }
+
+    // Same, with state owned by the hierarchy; not safe to call concurrently.
+    float distance(uint32_t s, uint32_t t) const { return distance(s, t, search); }
+
+    size_t size() const { return numVertices; }
+    size_t numUpwardEdges() const { return numEdges; }
+    size_t coreSize() const { return numCore; }
+
+    bool save(const std::string& path) const {
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f) return false;
+        Header header;
+        memcpy(header.magic, kMagic, sizeof(header.magic));
+        header.numVertices = numVertices;
+        header.numEdges = numEdges;
+        header.numCore = numCore;
+        size_t cells = numCore * numCore;
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+        ok = ok && fwrite(offsets, sizeof(uint32_t), numVertices + 1, f) == numVertices + 1;
+        ok = ok && fwrite(neighbors, sizeof(uint32_t), numEdges, f) == numEdges;
+        ok = ok && fwrite(weights, sizeof(float), numEdges, f) == numEdges;
+        ok = ok && fwrite(coreIndex, sizeof(uint32_t), numVertices, f) == numVertices;
+        ok = ok && fwrite(table, sizeof(float), cells, f) == cells;
+        return fclose(f) == 0 && ok;
+    }
+
+    // Maps a saved hierarchy read-only; returns false if the file is missing or was built for another vertex count.
+    bool map(const std::string& path, size_t expectedVertices) {
+        unmap();
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        void* data = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(Header)) {
+            data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (data == MAP_FAILED) return false;
+
+        const Header* header = static_cast<const Header*>(data);
+        size_t n = header->numVertices, m = header->numEdges, k = header->numCore;
+        size_t expectedSize = sizeof(Header) + (2 * n + 1 + m) * sizeof(uint32_t) + (m + k * k) * sizeof(float);
+        if (memcmp(header->magic, kMagic, sizeof(header->magic)) != 0 || n != expectedVertices ||
+            size_t(st.st_size) < expectedSize) {
+            munmap(data, st.st_size);
+            return false;
+        }
+
+        mapped = data;
+        mappedSize = st.st_size;
+        numVertices = n;
+        numEdges = m;
+        numCore = k;
+        const char* bytes = static_cast<const char*>(data) + sizeof(Header);
+        offsets = reinterpret_cast<const uint32_t*>(bytes);
+        neighbors = offsets + n + 1;
+        weights = reinterpret_cast<const float*>(neighbors + m);
+        coreIndex = reinterpret_cast<const uint32_t*>(weights + m);
+        table = reinterpret_cast<const float*>(coreIndex + n);
+        return true;
+    }
+
+   private:
+    ContractionHierarchy(const ContractionHierarchy&);
+    ContractionHierarchy& operator=(const ContractionHierarchy&);
+
+    typedef std::pair<uint32_t, float> Arc;  // head, length
+
+    static const uint32_t kNotCore = std::numeric_limits<uint32_t>::max();
+
+    // Dijkstra from source over upward edges, stopping at core vertices, which are collected in access. Vertices
+    // reached are added to the touched list of the state.
+    void upwardSearch(uint32_t source, std::vector<float>& d, std::vector<uint32_t>& access, Search& state) const {
+        const float kInf = std::numeric_limits<float>::max();
+        std::vector<std::pair<float, uint32_t>>& heap = state.heap;
+        std::greater<std::pair<float, uint32_t>> later;
+        d[source] = 0.f;
+        state.touched.push_back(source);
+        heap.assign(1, std::make_pair(0.f, source));
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            float key = heap.back().first;
+            uint32_t u = heap.back().second;
+            heap.pop_back();
+            if (key != d[u]) continue;  // stale entry
+            if (coreIndex[u] != kNotCore) {
+                access.push_back(u);
+                continue;
+            }
+
+            // stall on demand: a higher neighbor already reaches u on a shorter path, so u is on no shortest up-path
+            bool stalled = false;
+            for (uint32_t e = offsets[u]; e < offsets[u + 1] && !stalled; ++e) {
+                stalled = d[neighbors[e]] != kInf && d[neighbors[e]] + weights[e] < key;
+            }
+            if (stalled) continue;
+            for (uint32_t e = offsets[u]; e < offsets[u + 1]; ++e) {
+                uint32_t v = neighbors[e];
+                float alt = key + weights[e];
+                if (alt < d[v]) {
+                    if (d[v] == kInf) state.touched.push_back(v);
+                    d[v] = alt;
+                    heap.push_back(std::make_pair(alt, v));
+                    std::push_heap(heap.begin(), heap.end(), later);
+                }
+            }
+        }
+    }
+
+    // Node contraction on a shrinking adjacency-list copy of the graph.
+    class Contraction {
+       public:
+        explicit Contraction(const EdgeGraph& graph)
+            : adjacency(graph.size()), contracted(graph.size(), 0), deletedNeighbors(graph.size(), 0),
+              priority(graph.size(), 0), position(graph.size(), uint32_t(kNone)) {
+            for (size_t u = 0; u < graph.size(); ++u) {
+                for (uint32_t e = graph.offsets[u]; e < graph.offsets[u + 1]; ++e) {
+                    adjacency[u].push_back(Arc(graph.neighbors[e], graph.weights[e]));
+                }
+            }
+        }
+
+        // Contracts vertices until at most coreSize remain, which are returned; up[v] receives the edges of v to
+        // vertices contracted after it or left in the core.
+        std::vector<uint32_t> run(size_t coreSize, std::vector<std::vector<Arc>>& up) {
+            size_t n = adjacency.size();
+            std::vector<uint32_t> remaining(n), dirty(n);
+            for (size_t v = 0; v < n; ++v) remaining[v] = dirty[v] = v;
+
+            while (remaining.size() > coreSize) {
+                updatePriorities(dirty);
+
+                // vertices cheaper than all their remaining neighbors form an independent set
+                std::vector<uint32_t> batch;
+                for (size_t i = 0; i < remaining.size(); ++i) {
+                    uint32_t v = remaining[i];
+                    bool minimal = true;
+                    for (size_t k = 0; k < adjacency[v].size() && minimal; ++k) {
+                        uint32_t u = adjacency[v][k].first;
+                        minimal = priority[v] < priority[u] || (priority[v] == priority[u] && v < u);
+                    }
+                    if (minimal) batch.push_back(v);
+                }
+
+                // shortcuts of the whole batch against the graph before any of it is removed
+                std::vector<std::vector<Shortcut>> found(batch.size());
+                parallelFor(batch.size(), 16, [&](size_t begin, size_t end) {
+                    Witness& witness = localWitness(n);
+                    for (size_t i = begin; i < end; ++i) {
+                        findShortcuts(batch[i], kContractionHops, kContractionSettles, witness, found[i]);
+                    }
+                });
+
+                std::vector<Shortcut> shortcuts;
+                dirty.clear();
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    uint32_t v = batch[i];
+                    up[v] = adjacency[v];
+                    contracted[v] = 1;
+                    for (size_t k = 0; k < adjacency[v].size(); ++k) {
+                        uint32_t u = adjacency[v][k].first;
+                        removeArc(u, v);
+                        ++deletedNeighbors[u];
+                        dirty.push_back(u);
+                    }
+                    std::vector<Arc>().swap(adjacency[v]);
+                    for (size_t k = 0; k < found[i].size(); ++k) {
+                        const Shortcut& s = found[i][k];
+                        shortcuts.push_back(s);
+                        shortcuts.push_back(Shortcut(s.second.first, Arc(s.first, s.second.second)));
+                    }
+                }
+                addArcs(shortcuts);
+                std::sort(dirty.begin(), dirty.end());
+                dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+                size_t kept = 0;
+                for (size_t i = 0; i < remaining.size(); ++i) {
+                    if (!contracted[remaining[i]]) remaining[kept++] = remaining[i];
+                }
+                remaining.resize(kept);
+            }
+            return remaining;
+        }
+
+        // Distances between the remaining vertices, which the graph among them preserves: row i holds those from
+        // core[i], in the order of core.
+        void coreDistances(const std::vector<uint32_t>& core, float* table) const {
+            size_t k = core.size();
+            std::vector<uint32_t> local(adjacency.size(), uint32_t(kNone));
+            for (size_t i = 0; i < k; ++i) local[core[i]] = i;
+            std::vector<uint32_t> offsets(k + 1, 0), targets;
+            std::vector<float> lengths;
+            for (size_t i = 0; i < k; ++i) {
+                const std::vector<Arc>& arcs = adjacency[core[i]];
+                for (size_t j = 0; j < arcs.size(); ++j) {
+                    targets.push_back(local[arcs[j].first]);
+                    lengths.push_back(arcs[j].second);
+                }
+                offsets[i + 1] = targets.size();
+            }
+
+            parallelFor(k, 16, [&](size_t begin, size_t end) {
+                std::vector<std::pair<float, uint32_t>> heap;
+                std::greater<std::pair<float, uint32_t>> later;
+                for (size_t i = begin; i < end; ++i) {
+                    float* dist = table + i * k;
+                    std::fill(dist, dist + k, std::numeric_limits<float>::max());
+                    dist[i] = 0.f;
+                    heap.assign(1, std::make_pair(0.f, uint32_t(i)));
+                    while (!heap.empty()) {
+                        std::pop_heap(heap.begin(), heap.end(), later);
+                        float d = heap.back().first;
+                        uint32_t u = heap.back().second;
+                        heap.pop_back();
+                        if (d != dist[u]) continue;
+                        for (uint32_t e = offsets[u]; e < offsets[u + 1]; ++e) {
+                            float alt = d + lengths[e];
+                            if (alt < dist[targets[e]]) {
+                                dist[targets[e]] = alt;
+                                heap.push_back(std::make_pair(alt, targets[e]));
+                                std::push_heap(heap.begin(), heap.end(), later);
+                            }
+                        }
+                    }
+                }
+            });
+        }
+
+       private:
+        typedef std::pair<uint32_t, Arc> Shortcut;  // tail, (head, length)
+
+        static const uint32_t kNone = std::numeric_limits<uint32_t>::max();
+
+        // Witness searches stop after this many edges or settled vertices, which can only add unnecessary
+        // shortcuts. Estimating priorities uses tighter limits than the contraction itself. Vertices of higher degree
+        // than kWitnessDegree get no witness searches at all: on a surface mesh they make up the dense top of the
+        // hierarchy, where witnesses are rare and each search would cost the square of the degree.
+        static const uint32_t kSimulationHops = 2;
+        static const size_t kSimulationSettles = 50;
+        static const uint32_t kContractionHops = 8;
+        static const size_t kContractionSettles = 500;
+        static const size_t kWitnessDegree = 32;
+
+        // Scratch for bounded Dijkstra searches, reset in O(touched) after every search.
+        struct Witness {
+            std::vector<float> dist;
+            std::vector<uint32_t> hops;
+            std::vector<char> target;
+            std::vector<uint32_t> touched;
+            std::vector<std::pair<float, uint32_t>> heap;
+        };
+
+        static Witness& localWitness(size_t n) {
+            static thread_local Witness witness;
+            if (witness.dist.size() != n) {
+                witness.dist.assign(n, std::numeric_limits<float>::max());
+                witness.hops.assign(n, 0);
+                witness.target.assign(n, 0);
+            }
+            return witness;
+        }
+
+        void removeArc(uint32_t u, uint32_t v) {
+            std::vector<Arc>& arcs = adjacency[u];
+            for (size_t k = 0; k < arcs.size(); ++k) {
+                if (arcs[k].first == v) {
+                    arcs[k] = arcs.back();
+                    arcs.pop_back();
+                    return;
+                }
+            }
+        }
+
+        // Inserts the shortcuts, keeping the shorter of parallel arcs. Grouping them by tail makes this linear in
+        // the adjacency lists touched, however many shortcuts a high-degree vertex receives.
+        void addArcs(std::vector<Shortcut>& shortcuts) {
+            std::sort(shortcuts.begin(), shortcuts.end());
+            for (size_t i = 0; i < shortcuts.size();) {
+                uint32_t u = shortcuts[i].first;
+                std::vector<Arc>& arcs = adjacency[u];
+                for (size_t k = 0; k < arcs.size(); ++k) position[arcs[k].first] = k;
+                for (; i < shortcuts.size() && shortcuts[i].first == u; ++i) {
+                    const Arc& arc = shortcuts[i].second;
+                    if (position[arc.first] == kNone) {
+                        position[arc.first] = arcs.size();
+                        arcs.push_back(arc);
+                    } else {
+                        float& length = arcs[position[arc.first]].second;
+                        length = std::min(length, arc.second);
+                    }
+                }
+                for (size_t k = 0; k < arcs.size(); ++k) position[arcs[k].first] = kNone;
+            }
+        }
+
+        // Shortcuts (u, w) needed when v is removed, for u < w: those whose path u-v-w has no strictly shorter
+        // witness. Witnesses may pass through other vertices of the batch: a shortest path never uses a batch vertex
+        // whose shortcut was dropped, since the witness would make it shorter.
+        void findShortcuts(uint32_t v, uint32_t maxHops, size_t maxSettles, Witness& witness,
+                           std::vector<Shortcut>& out) const {
+            const std::vector<Arc>& arcs = adjacency[v];
+            out.clear();
+            if (arcs.size() > kWitnessDegree) {
+                for (size_t i = 0; i < arcs.size(); ++i) {
+                    for (size_t j = 0; j < arcs.size(); ++j) {
+                        if (arcs[j].first <= arcs[i].first) continue;
+                        out.push_back(Shortcut(arcs[i].first, Arc(arcs[j].first, arcs[i].second + arcs[j].second)));
+                    }
+                }
+                return;
+            }
+            for (size_t i = 0; i < arcs.size(); ++i) {
+                uint32_t u = arcs[i].first;
+                float bound = -1.f;
+                size_t targets = 0;
+                for (size_t j = 0; j < arcs.size(); ++j) {
+                    if (arcs[j].first <= u) continue;
+                    bound = std::max(bound, arcs[i].second + arcs[j].second);
+                    witness.target[arcs[j].first] = 1;
+                    ++targets;
+                }
+                if (targets == 0) continue;
+
+                witnessSearch(u, v, bound, targets, maxHops, maxSettles, witness);
+                for (size_t j = 0; j < arcs.size(); ++j) {
+                    uint32_t w = arcs[j].first;
+                    float via = arcs[i].second + arcs[j].second;
+                    if (w > u && witness.dist[w] >= via) out.push_back(Shortcut(u, Arc(w, via)));
+                    witness.target[w] = 0;
+                }
+                for (size_t k = 0; k < witness.touched.size(); ++k) {
+                    witness.dist[witness.touched[k]] = std::numeric_limits<float>::max();
+                }
+                witness.touched.clear();
+            }
+        }
+
+        // Search from source avoiding skip, until the marked targets are settled or nothing shorter than bound is
+        // left within the limits.
+        void witnessSearch(uint32_t source, uint32_t skip, float bound, size_t targets, uint32_t maxHops,
+                           size_t maxSettles, Witness& witness) const {
+            std::vector<std::pair<float, uint32_t>>& heap = witness.heap;
+            std::greater<std::pair<float, uint32_t>> later;
+            heap.clear();
+            witness.dist[source] = 0.f;
+            witness.hops[source] = 0;
+            witness.touched.push_back(source);
+            heap.push_back(std::make_pair(0.f, source));
+            for (size_t settled = 0; !heap.empty() && settled < maxSettles && targets > 0;) {
+                std::pop_heap(heap.begin(), heap.end(), later);
+                float d = heap.back().first;
+                uint32_t u = heap.back().second;
+                heap.pop_back();
+                if (d >= bound) break;
+                if (d != witness.dist[u]) continue;
+                ++settled;
+                targets -= witness.target[u];
+                if (witness.hops[u] == maxHops) continue;
+                for (size_t k = 0; k < adjacency[u].size(); ++k) {
+                    uint32_t w = adjacency[u][k].first;
+                    float alt = d + adjacency[u][k].second;
+                    if (w == skip || alt >= witness.dist[w]) continue;
+                    if (witness.dist[w] == std::numeric_limits<float>::max()) witness.touched.push_back(w);
+                    witness.dist[w] = alt;
+                    witness.hops[w] = witness.hops[u] + 1;
+                    heap.push_back(std::make_pair(alt, w));
+                    std::push_heap(heap.begin(), heap.end(), later);
+                }
+            }
+        }
+
+        // Edge difference (shortcuts added minus edges removed) plus the number of contracted neighbors, which
+        // spreads contraction evenly over the mesh.
+        void updatePriorities(const std::vector<uint32_t>& vertexList) {
+            parallelFor(vertexList.size(), 64, [&](size_t begin, size_t end) {
+                Witness& witness = localWitness(adjacency.size());
+                std::vector<Shortcut> shortcuts;
+                for (size_t i = begin; i < end; ++i) {
+                    uint32_t v = vertexList[i];
+                    int degree = int(adjacency[v].size());
+                    int added = degree * (degree - 1) / 2;
+                    if (size_t(degree) <= kWitnessDegree) {
+                        findShortcuts(v, kSimulationHops, kSimulationSettles, witness, shortcuts);
+                        added = int(shortcuts.size());
+                    }
+                    priority[v] = added - degree + deletedNeighbors[v];
+                }
+            });
+        }
+
+        std::vector<std::vector<Arc>> adjacency;
+        std::vector<char> contracted;
+        std::vector<int> deletedNeighbors, priority;
+        std::vector<uint32_t> position;  // index of an arc in the adjacency list being merged into, or kNone
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t numVertices;
+        uint32_t numEdges;
+        uint32_t numCore;
+    };
+    static constexpr const char* kMagic = "GEOCH001";
+
+    void unmap() {
+        if (mapped) munmap(mapped, mappedSize);
+        mapped = nullptr;
+        mappedSize = 0;
+    }
+
+    size_t numVertices, numEdges, numCore;
+    const uint32_t* offsets;  // upward graph: edges of v to vertices contracted after it, none for core vertices
+    const uint32_t* neighbors;
+    const float* weights;
+    const uint32_t* coreIndex;  // row of v in the table, or kNotCore
+    const float* table;         // numCore x numCore distances between core vertices
+
+    void* mapped;
+    size_t mappedSize;
+    struct {
+        std::vector<uint32_t> offsets, neighbors, coreIndex;
+        std::vector<float> weights, table;
+    } storage;
+    mutable Search search;
+};
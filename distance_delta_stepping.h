@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "DistanceAlgorithm.h"
+#include "edge_graph.h"
+#include "parallel.h"
+
+// Delta-stepping (Meyer & Sanders 2003): a parallel label-correcting shortest path search for single queries on
+// large meshes. Vertices are kept in buckets of width delta; all vertices of the lowest bucket are relaxed at once,
+// first along light edges (shorter than delta) until the bucket stays empty, then along heavy edges. Relaxations
+// are atomic minimums on the bit patterns of the float distances, which order like the values since they are never
+// negative. Every distance is the smallest left-to-right float sum over all paths, exactly as Dijkstra computes it,
+// so the results are identical.
+class DeltaSteppingAlgorithm : public DistanceAlgorithm {
+   public:
+    // delta is deltaScale times the median edge length.
+    explicit DeltaSteppingAlgorithm(float deltaScale = 4.f)
+        : deltaScale(deltaScale), delta(1.f), graph(), lightEnd(), numBuckets(1), dist(), distSize(0), inSettled(),
+          buckets() {}
+
+    void updatePositions(const float* positions) override final {
+        DistanceAlgorithm::updatePositions(positions);
+        graph.updateWeights(mesh->positions().data());
+        splitEdges();
+    }
+
+    std::vector<float> propagate(int src) override final {
+        return search(std::vector<std::pair<uint32_t, float>>(1, std::make_pair(uint32_t(src), 0.f)));
+    }
+
+    std::vector<float> propagate(const SurfacePoint& src) override final {
+        std::vector<std::pair<uint32_t, float>> seeds;
+        glm::vec3 p = position(src);
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = mesh->indices()[3 * src.face + k];
+            seeds.push_back(std::make_pair(v, glm::length(mesh->positions()[v] - p)));
+        }
+        return search(seeds);
+    }
+
+    float getDelta() const { return delta; }
+
+   protected:
+    // Rows get reordered by splitEdges(), so this keeps its own copy of the mesh graph.
+    void prepare() override final {
+        graph = mesh->graph();
+        splitEdges();
+    }
+
+   private:
+    static uint32_t bits(float f) {
+        uint32_t b;
+        memcpy(&b, &f, sizeof(b));
+        return b;
+    }
+
+    static float value(uint32_t b) {
+        float f;
+        memcpy(&f, &b, sizeof(f));
+        return f;
+    }
+
+    size_t bucketOf(float d) const { return size_t(d / delta); }
+
+    // Picks delta from the edge length distribution and moves the light edges of every row to its front. Rows are
+    // no longer sorted by neighbor afterwards, which nothing here relies on.
+    void splitEdges() {
+        std::vector<float> lengths(graph.weights);
+        float median = 1.f, longest = 0.f;
+        if (!lengths.empty()) {
+            std::nth_element(lengths.begin(), lengths.begin() + lengths.size() / 2, lengths.end());
+            median = lengths[lengths.size() / 2];
+            longest = *std::max_element(graph.weights.begin(), graph.weights.end());
+        }
+        delta = median > 0.f ? deltaScale * median : 1.f;
+        // a relaxation lands at most longest / delta buckets ahead, so that many (plus the current one) are live
+        numBuckets = size_t(longest / delta) + 2;
+
+        size_t n = graph.size();
+        lightEnd.resize(n);
+        parallelFor(n, 4096, [&](size_t begin, size_t end) {
+            for (size_t u = begin; u < end; ++u) {
+                uint32_t first = graph.offsets[u], last = graph.offsets[u + 1];
+                uint32_t light = first;
+                for (uint32_t e = first; e < last; ++e) {
+                    if (graph.weights[e] < delta) {
+                        std::swap(graph.neighbors[e], graph.neighbors[light]);
+                        std::swap(graph.weights[e], graph.weights[light]);
+                        ++light;
+                    }
+                }
+                lightEnd[u] = light;
+            }
+        });
+    }
+
+    // Lowers v to d; if that improved it, files v in the bucket of d of the given slot.
+    void relax(uint32_t v, float d, size_t slot) {
+        uint32_t b = bits(d);
+        uint32_t old = dist[v].load(std::memory_order_relaxed);
+        while (b < old) {
+            if (dist[v].compare_exchange_weak(old, b, std::memory_order_relaxed)) {
+                buckets[slot][bucketOf(d) % numBuckets].push_back(v);
+                return;
+            }
+        }
+    }
+
+    // Relaxes edges [offsets[u], lightEnd[u]) or [lightEnd[u], offsets[u + 1]) of the given vertices in parallel.
+    // Each block of work gets its own slot of buckets, so insertions never contend.
+    void relaxAll(const std::vector<uint32_t>& vertexList, bool heavy) {
+        size_t slots = buckets.size();
+        size_t grain = std::max<size_t>(256, (vertexList.size() + slots - 1) / slots);
+        parallelFor(vertexList.size(), grain, [&](size_t begin, size_t end) {
+            size_t slot = begin / grain;
+            for (size_t i = begin; i < end; ++i) {
+                uint32_t u = vertexList[i];
+                float d = value(dist[u].load(std::memory_order_relaxed));
+                uint32_t first = heavy ? lightEnd[u] : graph.offsets[u];
+                uint32_t last = heavy ? graph.offsets[u + 1] : lightEnd[u];
+                for (uint32_t e = first; e < last; ++e) relax(graph.neighbors[e], d + graph.weights[e], slot);
+            }
+        });
+    }
+
+    // Moves the contents of bucket b of every slot into out.
+    bool take(size_t b, std::vector<uint32_t>& out) {
+        out.clear();
+        for (size_t s = 0; s < buckets.size(); ++s) {
+            std::vector<uint32_t>& bucket = buckets[s][b % numBuckets];
+            out.insert(out.end(), bucket.begin(), bucket.end());
+            bucket.clear();
+        }
+        return !out.empty();
+    }
+
+    std::vector<float> search(const std::vector<std::pair<uint32_t, float>>& seeds) {
+        size_t n = graph.size();
+        if (!dist || distSize != n) {
+            dist.reset(new std::atomic<uint32_t>[n]);
+            distSize = n;
+            inSettled.assign(n, 0);
+        }
+        const uint32_t unreached = bits(std::numeric_limits<float>::max());
+        parallelFor(n, 16384, [&](size_t begin, size_t end) {
+            for (size_t v = begin; v < end; ++v) dist[v].store(unreached, std::memory_order_relaxed);
+        });
+        buckets.assign(numThreads(), std::vector<std::vector<uint32_t>>(numBuckets));
+
+        size_t current = std::numeric_limits<size_t>::max();
+        for (size_t i = 0; i < seeds.size(); ++i) {
+            relax(seeds[i].first, seeds[i].second, 0);
+            current = std::min(current, bucketOf(seeds[i].second));
+        }
+
+        std::vector<uint32_t> frontier, settled;
+        while (current != std::numeric_limits<size_t>::max()) {
+            // a heavy edge can still round back into the current bucket, so repeat until it stays empty
+            while (take(current, frontier)) {
+                settled.clear();
+                do {
+                    // skip entries of vertices that were improved into an earlier bucket after being filed here
+                    size_t kept = 0;
+                    for (size_t i = 0; i < frontier.size(); ++i) {
+                        uint32_t v = frontier[i];
+                        if (bucketOf(value(dist[v].load(std::memory_order_relaxed))) != current) continue;
+                        frontier[kept++] = v;
+                        if (!inSettled[v]) {
+                            inSettled[v] = 1;
+                            settled.push_back(v);
+                        }
+                    }
+                    frontier.resize(kept);
+                    relaxAll(frontier, false);
+                } while (take(current, frontier));
+                relaxAll(settled, true);
+                for (size_t i = 0; i < settled.size(); ++i) inSettled[settled[i]] = 0;
+            }
+
+            size_t next = std::numeric_limits<size_t>::max();
+            for (size_t b = current + 1; b < current + numBuckets && next > b; ++b) {
+                for (size_t s = 0; s < buckets.size(); ++s) {
+                    if (!buckets[s][b % numBuckets].empty()) next = b;
+                }
+            }
+            current = next;
+        }
+
+        std::vector<float> result(n);
+        parallelFor(n, 16384, [&](size_t begin, size_t end) {
+            for (size_t v = begin; v < end; ++v) result[v] = value(dist[v].load(std::memory_order_relaxed));
+        });
+        return result;
+    }
+
+    float deltaScale, delta;
+    EdgeGraph graph;                 // rows hold light edges first
+    std::vector<uint32_t> lightEnd;  // end of the light edges of each row
+    size_t numBuckets;               // buckets in flight, used cyclically
+
+    std::unique_ptr<std::atomic<uint32_t>[]> dist;  // float bits
+    size_t distSize;
+    std::vector<uint8_t> inSettled;  // marks the vertices of settled during a phase of the current bucket
+    std::vector<std::vector<std::vector<uint32_t>>> buckets;  // [slot][bucket % numBuckets]
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <limits>
 #include <queue>
@@ -7,46 +9,426 @@
 #include <utility>
 
 #include "DistanceAlgorithm.h"
+#include "edge_graph.h"
+#include "kd_tree.h"
 
 class DijkstraAlgorithm : public DistanceAlgorithm {
    public:
-    DijkstraAlgorithm() : adjacencies() {}
-
-    void load(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes) override final {
-        size_t numVerts = attrib.vertices.size() / 3;
-        adjacencies.resize(numVerts);
-
-        for (size_t s = 0; s < shapes.size(); ++s) {
-            const tinyobj::shape_t& shape = shapes[s];
-            size_t numFaces = shape.mesh.num_face_vertices.size();
-
-            for (size_t f = 0; f < numFaces; f++) {
-                int idx0 = shape.mesh.indices[3 * f + 0].vertex_index;
-                int idx1 = shape.mesh.indices[3 * f + 1].vertex_index;
-                int idx2 = shape.mesh.indices[3 * f + 2].vertex_index;
-
-                glm::vec3 v[3];
-                for (int c = 0; c < 3; c++) {
-                    v[0][c] = attrib.vertices[3 * idx0 + c];
-                    v[1][c] = attrib.vertices[3 * idx1 + c];
-                    v[2][c] = attrib.vertices[3 * idx2 + c];
-                }
+    static const uint32_t kNoPredecessor = UINT32_MAX;
+
+    // Search state reused across queries, one per concurrent caller. A label counts as unreached unless it is stamped
+    // with the current epoch, so starting a query clears nothing and a bounded search costs only what it reaches.
+    // Once its storage has grown, queries through it allocate nothing.
+    class Workspace {
+       public:
+        Workspace() : dist(), stamp(), epoch(0), heap() {}
 
-                addEdge(idx0, idx1, glm::length(v[1] - v[0]));
-                addEdge(idx0, idx2, glm::length(v[2] - v[0]));
-                addEdge(idx1, idx2, glm::length(v[2] - v[1]));
+       private:
+        friend class DijkstraAlgorithm;
+        typedef std::pair<float, uint32_t> entry_t;  // key, index
+
+        void begin(size_t n) {
+            if (stamp.size() != n) {
+                dist.resize(n);
+                stamp.assign(n, 0);
+                epoch = 0;
+            }
+            if (++epoch == 0) {  // wrapped around; old stamps could match again
+                std::fill(stamp.begin(), stamp.end(), 0);
+                epoch = 1;
             }
+            heap.clear();
+        }
+
+        float get(size_t v) const { return stamp[v] == epoch ? dist[v] : std::numeric_limits<float>::max(); }
+
+        void set(size_t v, float d) {
+            dist[v] = d;
+            stamp[v] = epoch;
+        }
+
+        void push(float key, uint32_t v) {
+            heap.push_back(std::make_pair(key, v));
+            std::push_heap(heap.begin(), heap.end(), std::greater<entry_t>());
+        }
+
+        entry_t pop() {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<entry_t>());
+            entry_t top = heap.back();
+            heap.pop_back();
+            return top;
         }
+
+        std::vector<float> dist;
+        std::vector<uint32_t> stamp;
+        uint32_t epoch;
+        std::vector<entry_t> heap;
+    };
+
+    // Search state for bounded searches restricted to the vertices of a Euclidean ball. Labels are kept in dense
+    // arrays indexed by local id, the position of a vertex among the candidates of the ball, and an open addressing
+    // table maps vertex ids to local ids. Its storage grows with the largest ball searched, not with the mesh.
+    class BallWorkspace {
+       public:
+        BallWorkspace() : candidates(), slots(), shift(0), mask(0), dist(), heap() {}
+
+       private:
+        friend class DijkstraAlgorithm;
+        typedef std::pair<float, uint32_t> entry_t;  // key, local id
+        static const uint32_t kEmpty = UINT32_MAX;
+
+        // Indexes the current candidates, at most half filling the table.
+        void begin() {
+            shift = 28;
+            while ((size_t(1) << (32 - shift)) < 2 * candidates.size()) --shift;
+            slots.assign(size_t(1) << (32 - shift), std::make_pair(uint32_t(kEmpty), uint32_t(kEmpty)));
+            mask = slots.size() - 1;
+            for (uint32_t i = 0; i < candidates.size(); ++i) {
+                size_t s = slot(candidates[i].first);
+                while (slots[s].second != kEmpty) s = (s + 1) & mask;
+                slots[s] = std::make_pair(candidates[i].first, i);
+            }
+            dist.assign(candidates.size(), std::numeric_limits<float>::max());
+            heap.clear();
+        }
+
+        // Local id of vertex v, or kEmpty if it is outside the ball.
+        uint32_t find(uint32_t v) const {
+            for (size_t s = slot(v);; s = (s + 1) & mask) {
+                if (slots[s].first == v || slots[s].second == kEmpty) return slots[s].second;
+            }
+        }
+
+        size_t slot(uint32_t v) const { return uint32_t(v * 0x9e3779b1u) >> shift; }  // high bits mix best
+
+        void push(float key, uint32_t local) {
+            heap.push_back(std::make_pair(key, local));
+            std::push_heap(heap.begin(), heap.end(), std::greater<entry_t>());
+        }
+
+        entry_t pop() {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<entry_t>());
+            entry_t top = heap.back();
+            heap.pop_back();
+            return top;
+        }
+
+        std::vector<std::pair<uint32_t, float>> candidates;  // vertex, Euclidean distance; index is the local id
+        std::vector<std::pair<uint32_t, uint32_t>> slots;    // vertex, local id; by hashed vertex id
+        int shift;  // 32 - log2 of the table size
+        size_t mask;
+        std::vector<float> dist;  // by local id
+        std::vector<entry_t> heap;
+    };
+
+    DijkstraAlgorithm()
+        : graph(&mesh->graph()),
+          predecessors(),
+          distances(),
+          childOffsets(),
+          children(),
+          treeOrder(),
+          lastVertex(-1),
+          lastPoint(),
+          workspace() {}
+
+    // The moved mesh keeps the topology of the current graph and only recomputes the edge lengths.
+    void updatePositions(const float* positions) override final {
+        DistanceAlgorithm::updatePositions(positions);
+        graph = &mesh->graph();
     }
 
     std::vector<float> propagate(int src) override final {
-        typedef std::pair<float, size_t> queue_entry_t;  // distance, index
-        std::vector<float> dist(adjacencies.size(), std::numeric_limits<float>::max());
-        dist[src] = 0;
+        lastVertex = src;
+        search(lastSeeds(), distances, predecessors);
+        return distances;
+    }
+
+    std::vector<float> propagate(const SurfacePoint& src) override final {
+        lastVertex = -1;
+        lastPoint = src;
+        search(lastSeeds(), distances, predecessors);
+        return distances;
+    }
 
-        std::priority_queue<queue_entry_t, std::vector<queue_entry_t>, std::greater<queue_entry_t>> queue;
-        queue.push(std::make_pair(dist[0], 0));
+    // Does not record a shortest path tree, so path() still refers to the last propagate().
+    void propagateInto(int src, float* out) override final { propagateInto(uint32_t(src), out, workspace); }
 
+    // Writes the distances from src to all vertices into out, using only the heap of the workspace.
+    void propagateInto(uint32_t src, float* out, Workspace& ws) const {
+        std::fill(out, out + graph->size(), std::numeric_limits<float>::max());
+        ws.heap.clear();
+        out[src] = 0.f;
+        ws.push(0.f, src);
+        while (!ws.heap.empty()) {
+            Workspace::entry_t top = ws.pop();
+            uint32_t u = top.second;
+            if (out[u] != top.first) continue;  // stale entry
+
+            for (uint32_t e = graph->offsets[u]; e < graph->offsets[u + 1]; ++e) {
+                uint32_t v = graph->neighbors[e];
+                float alt = top.first + graph->weights[e];
+                if (alt < out[v]) {
+                    out[v] = alt;
+                    ws.push(alt, v);
+                }
+            }
+        }
+    }
+
+    // Re-runs the last query after updatePositions(). Evaluating the previous shortest path tree with the new edge
+    // lengths gives every vertex the length of a real path, i.e. an upper bound. Only vertices that some edge can
+    // now improve are queued and repaired by label correction, so small deformations touch little of the heap.
+    std::vector<float> propagateWarm() {
+        if (predecessors.size() != graph->size()) {
+            return lastVertex >= 0 ? propagate(lastVertex) : propagate(lastPoint);
+        }
+
+        std::vector<seed_t> seeds = lastSeeds();
+        buildChildren();
+        treeOrder.clear();
+        for (size_t i = 0; i < seeds.size(); ++i) {
+            uint32_t v = seeds[i].first;
+            if (predecessors[v] != v) continue;  // not a root of the old tree
+            if (std::find(treeOrder.begin(), treeOrder.end(), v) == treeOrder.end()) {
+                treeOrder.push_back(v);
+                distances[v] = seeds[i].second;
+            }
+            distances[v] = std::min(distances[v], seeds[i].second);
+        }
+        for (size_t i = 0; i < treeOrder.size(); ++i) {
+            uint32_t u = treeOrder[i];
+            for (uint32_t c = childOffsets[u]; c < childOffsets[u + 1]; ++c) {
+                uint32_t v = children[c];
+                distances[v] = distances[u] + graph->weight(u, v);
+                treeOrder.push_back(v);
+            }
+        }
+
+        queue_t queue;
+        for (size_t i = 0; i < seeds.size(); ++i) {
+            uint32_t v = seeds[i].first;
+            if (seeds[i].second < distances[v]) {
+                distances[v] = seeds[i].second;
+                predecessors[v] = v;
+                queue.push(std::make_pair(seeds[i].second, v));
+            }
+        }
+        for (size_t u = 0; u < graph->size(); ++u) {
+            if (distances[u] == std::numeric_limits<float>::max()) continue;
+            for (uint32_t e = graph->offsets[u]; e < graph->offsets[u + 1]; ++e) {
+                uint32_t v = graph->neighbors[e];
+                float alt = distances[u] + graph->weights[e];
+                if (alt < distances[v]) {
+                    distances[v] = alt;
+                    predecessors[v] = u;
+                    queue.push(std::make_pair(alt, v));
+                }
+            }
+        }
+        settle(queue, distances, predecessors);
+        return distances;
+    }
+
+    // Full field from src without touching the stored tree, so it may be called concurrently.
+    void distancesFrom(uint32_t src, std::vector<float>& dist, std::vector<uint32_t>& pred) const {
+        search(std::vector<seed_t>(1, std::make_pair(size_t(src), 0.f)), dist, pred);
+    }
+
+    // Distance to the nearest of count sources; pred leads back to that source.
+    void distancesFromNearest(const uint32_t* sources, size_t count, std::vector<float>& dist,
+                              std::vector<uint32_t>& pred) const {
+        std::vector<seed_t> seeds;
+        for (size_t i = 0; i < count; ++i) seeds.push_back(std::make_pair(size_t(sources[i]), 0.f));
+        search(seeds, dist, pred);
+    }
+
+    // Vertices at most radius from src with their distances, nearest first. The search stops at the radius.
+    void distancesWithin(uint32_t src, float radius, std::vector<std::pair<uint32_t, float>>& out) const {
+        Workspace ws;
+        distancesWithin(src, radius, out, ws);
+    }
+
+    // Same in time proportional to the part of the graph within the radius.
+    void distancesWithin(uint32_t src, float radius, std::vector<std::pair<uint32_t, float>>& out,
+                         Workspace& ws) const {
+        ws.begin(graph->size());
+        out.clear();
+        ws.set(src, 0.f);
+        ws.push(0.f, src);
+        while (!ws.heap.empty()) {
+            Workspace::entry_t top = ws.pop();
+            uint32_t u = top.second;
+            if (ws.get(u) != top.first) continue;  // stale entry
+            out.push_back(std::make_pair(u, top.first));
+
+            for (uint32_t e = graph->offsets[u]; e < graph->offsets[u + 1]; ++e) {
+                uint32_t v = graph->neighbors[e];
+                float alt = top.first + graph->weights[e];
+                if (alt <= radius && alt < ws.get(v)) {
+                    ws.set(v, alt);
+                    ws.push(alt, v);
+                }
+            }
+        }
+    }
+
+    // Same result, searching only the vertices within the Euclidean distance radius of src. The straight line is never
+    // longer than a path over the surface, so no other vertex can be within radius, and the search state covers only
+    // the ball instead of the whole mesh. index must hold the current positions, such as the tree of a
+    // WorldSpaceAlgorithm on the same mesh.
+    //
+    // This pays off for small radii on large meshes, where the labels of a Workspace are spread over an array per
+    // vertex that misses the cache on every query and must be allocated per caller. On a 2000 x 2000 grid a ball of
+    // 36 vertices takes 4 us, against 23 us through a warm Workspace and 3.8 ms through a new one. At about 900
+    // vertices the two warm searches are equally fast, and beyond that the Workspace is faster.
+    void distancesWithin(uint32_t src, float radius, const KdTree& index, std::vector<std::pair<uint32_t, float>>& out,
+                         BallWorkspace& ws) const {
+        out.clear();
+        // slightly larger, since a sum of rounded edge lengths may come out below the rounded straight distance
+        index.within(mesh->positions()[src], radius * 1.0001f, ws.candidates);
+        ws.begin();
+        uint32_t local = ws.find(src);
+        if (local == BallWorkspace::kEmpty) return;
+        ws.dist[local] = 0.f;
+        ws.push(0.f, local);
+        while (!ws.heap.empty()) {
+            BallWorkspace::entry_t top = ws.pop();
+            if (ws.dist[top.second] != top.first) continue;  // stale entry
+            uint32_t u = ws.candidates[top.second].first;
+            out.push_back(std::make_pair(u, top.first));
+
+            for (uint32_t e = graph->offsets[u]; e < graph->offsets[u + 1]; ++e) {
+                float alt = top.first + graph->weights[e];
+                if (alt > radius) continue;
+                uint32_t v = ws.find(graph->neighbors[e]);
+                if (v != BallWorkspace::kEmpty && alt < ws.dist[v]) {
+                    ws.dist[v] = alt;
+                    ws.push(alt, v);
+                }
+            }
+        }
+    }
+
+    // Distances from count sources in one traversal, interleaved: out[v * count + i] is the distance from sources[i]
+    // to v. Every vertex carries up to 16 lanes, one per source, and an edge relaxes all of them with one vector add
+    // and min, so each adjacency row is read once for all sources. The search is label correcting, ordered by the
+    // smallest lane of a vertex; for nearby sources the other lanes are then nearly final as well and most vertices
+    // are visited once. Sources far apart cause repeated corrections, so a group that exceeds a visit budget is
+    // split in halves and searched again. Each lane equals distancesFrom() of its source.
+    void distancesFrom(const uint32_t* sources, size_t count, std::vector<float>& out) const {
+        out.resize(graph->size() * count);
+        std::vector<float> lanes;
+        for (size_t first = 0; first < count; first += 16) {
+            distancesFromGroup(sources, first, std::min<size_t>(16, count - first), count, out, lanes);
+        }
+    }
+
+    // Exact distance between two vertices by A* search, or float max if dst is unreachable. heuristic(v) must never
+    // overestimate the distance from v to dst; it need not be consistent, since improved vertices are reopened.
+    template <typename Heuristic>
+    float distance(uint32_t src, uint32_t dst, Heuristic heuristic) const {
+        Workspace ws;
+        return distance(src, dst, heuristic, ws);
+    }
+
+    // Same, touching only the labels the search reaches.
+    template <typename Heuristic>
+    float distance(uint32_t src, uint32_t dst, Heuristic heuristic, Workspace& ws) const {
+        ws.begin(graph->size());
+        ws.set(src, 0.f);
+        ws.push(heuristic(src), src);
+
+        while (!ws.heap.empty()) {
+            Workspace::entry_t top = ws.pop();  // distance + heuristic, index
+            uint32_t u = top.second;
+            float d = ws.get(u);
+            if (u == dst) return d;
+            if (top.first > d + heuristic(u)) continue;  // stale entry
+
+            for (uint32_t e = graph->offsets[u]; e < graph->offsets[u + 1]; ++e) {
+                uint32_t v = graph->neighbors[e];
+                float alt = d + graph->weights[e];
+                if (alt < ws.get(v)) {
+                    ws.set(v, alt);
+                    ws.push(alt + heuristic(v), v);
+                }
+            }
+        }
+        return std::numeric_limits<float>::max();
+    }
+
+    // A* guided by the straight-line distance to dst.
+    float distance(uint32_t src, uint32_t dst) const {
+        const std::vector<glm::vec3>& p = mesh->positions();
+        return distance(src, dst, [&](uint32_t v) { return glm::length(p[dst] - p[v]); });
+    }
+
+    float distance(uint32_t src, uint32_t dst, Workspace& ws) const {
+        const std::vector<glm::vec3>& p = mesh->positions();
+        return distance(src, dst, [&](uint32_t v) { return glm::length(p[dst] - p[v]); }, ws);
+    }
+
+    bool appendPath(uint32_t target, std::vector<uint32_t>& path) const override final {
+        if (target >= predecessors.size() || predecessors[target] == kNoPredecessor) return false;
+
+        size_t first = path.size();
+        uint32_t v = target;
+        path.push_back(v);
+        while (predecessors[v] != v) {  // seeds are their own predecessor
+            v = predecessors[v];
+            path.push_back(v);
+        }
+        std::reverse(path.begin() + first, path.end());
+        return true;
+    }
+
+    // Shortest path tree of the last propagation. Seeds are their own predecessor, unreached vertices have
+    // kNoPredecessor.
+    const std::vector<uint32_t>& getPredecessors() const { return predecessors; }
+
+    const EdgeGraph& getGraph() const { return *graph; }
+
+   protected:
+    void prepare() override final { graph = &mesh->graph(); }
+
+   private:
+    typedef std::pair<size_t, float> seed_t;         // index, initial distance
+    typedef std::pair<float, size_t> queue_entry_t;  // distance, index
+    typedef std::priority_queue<queue_entry_t, std::vector<queue_entry_t>, std::greater<queue_entry_t>> queue_t;
+
+    // Seeds of the last query at the current vertex positions. A surface point seeds the corners of its face with
+    // their straight-line distance to the point, which is exact inside the flat triangle.
+    std::vector<seed_t> lastSeeds() const {
+        std::vector<seed_t> seeds;
+        if (lastVertex >= 0) {
+            seeds.push_back(std::make_pair(size_t(lastVertex), 0.f));
+        } else {
+            glm::vec3 p = position(lastPoint);
+            for (int k = 0; k < 3; k++) {
+                size_t v = mesh->indices()[3 * lastPoint.face + k];
+                seeds.push_back(std::make_pair(v, glm::length(mesh->positions()[v] - p)));
+            }
+        }
+        return seeds;
+    }
+
+    void search(const std::vector<seed_t>& seeds, std::vector<float>& dist, std::vector<uint32_t>& pred) const {
+        dist.assign(graph->size(), std::numeric_limits<float>::max());
+        pred.assign(graph->size(), uint32_t(kNoPredecessor));
+
+        queue_t queue;
+        for (size_t i = 0; i < seeds.size(); ++i) {
+            if (seeds[i].second < dist[seeds[i].first]) {
+                dist[seeds[i].first] = seeds[i].second;
+                pred[seeds[i].first] = seeds[i].first;
+                queue.push(std::make_pair(seeds[i].second, seeds[i].first));
+            }
+        }
+        settle(queue, dist, pred);
+    }
+
+    void settle(queue_t& queue, std::vector<float>& dist, std::vector<uint32_t>& pred) const {
         while (!queue.empty()) {
             const queue_entry_t& entry = queue.top();
             float u_dist = entry.first;
@@ -54,25 +436,124 @@ class DijkstraAlgorithm : public DistanceAlgorithm {
             queue.pop();
             if (dist[u] != u_dist) continue;  // stale entry
 
-            for (auto iter = adjacencies[u].begin(); iter != adjacencies[u].end(); ++iter) {
-                size_t v = iter->first;
-                float alt = u_dist + iter->second;
+            for (uint32_t e = graph->offsets[u]; e < graph->offsets[u + 1]; ++e) {
+                size_t v = graph->neighbors[e];
+                float alt = u_dist + graph->weights[e];
 
                 if (alt < dist[v]) {
                     dist[v] = alt;
+                    pred[v] = u;
                     queue.push(std::make_pair(alt, v));
                 }
             }
         }
+    }
+
+    // Lanes [first, first + count) of the interleaved output of distancesFrom() with stride sources.
+    void distancesFromGroup(const uint32_t* sources, size_t first, size_t count, size_t stride, std::vector<float>& out,
+                            std::vector<float>& lanes) const {
+        size_t n = graph->size();
+        size_t width = count <= 4 ? 4 : count <= 8 ? 8 : 16;
+        bool done;
+        if (count == 1) {
+            std::vector<uint32_t> pred;
+            distancesFrom(sources[first], lanes, pred);
+            done = true;
+            width = 1;
+        } else if (width == 4) {
+            done = multiSearch<4>(sources + first, count, lanes);
+        } else if (width == 8) {
+            done = multiSearch<8>(sources + first, count, lanes);
+        } else {
+            done = multiSearch<16>(sources + first, count, lanes);
+        }
+
+        if (!done) {
+            distancesFromGroup(sources, first, count / 2, stride, out, lanes);
+            distancesFromGroup(sources, first + count / 2, count - count / 2, stride, out, lanes);
+            return;
+        }
+        for (size_t v = 0; v < n; ++v) {
+            for (size_t i = 0; i < count; ++i) out[v * stride + first + i] = lanes[v * width + i];
+        }
+    }
+
+    // W-lane search for count <= W sources; unused lanes stay unreached. Gives up and returns false after visiting
+    // four times as many vertices as the graph has.
+    template <size_t W>
+    bool multiSearch(const uint32_t* sources, size_t count, std::vector<float>& dist) const {
+        const float kInf = std::numeric_limits<float>::max();
+        size_t n = graph->size();
+        dist.assign(n * W, kInf);
+        std::vector<float> queued(n, kInf);  // smallest key v is queued with, or kInf
+        std::priority_queue<std::pair<float, uint32_t>, std::vector<std::pair<float, uint32_t>>,
+                            std::greater<std::pair<float, uint32_t>>>
+            queue;
+        for (size_t i = 0; i < count; ++i) {
+            dist[sources[i] * W + i] = 0.f;
+            queued[sources[i]] = 0.f;
+            queue.push(std::make_pair(0.f, sources[i]));
+        }
+
+        size_t budget = 4 * n;
+        while (!queue.empty()) {
+            float key = queue.top().first;
+            uint32_t u = queue.top().second;
+            queue.pop();
+            if (queued[u] != key) continue;  // stale entry
+            queued[u] = kInf;
+            if (budget-- == 0) return false;
 
-        return dist;
+            // fixed-size loops over local copies, so the compiler keeps the lanes in vector registers
+            float du[W], dv[W];
+            std::copy(&dist[u * W], &dist[u * W] + W, du);
+            for (uint32_t e = graph->offsets[u]; e < graph->offsets[u + 1]; ++e) {
+                uint32_t v = graph->neighbors[e];
+                float w = graph->weights[e];
+                float* row = &dist[v * W];
+                std::copy(row, row + W, dv);
+                int improved = 0;
+                for (size_t l = 0; l < W; ++l) {
+                    float alt = du[l] + w;
+                    improved |= alt < dv[l];
+                    dv[l] = alt < dv[l] ? alt : dv[l];
+                }
+                if (!improved) continue;
+                std::copy(dv, dv + W, row);
+                float low = dv[0];
+                for (size_t l = 1; l < W; ++l) low = std::min(low, dv[l]);
+                if (low < queued[v]) {
+                    queued[v] = low;
+                    queue.push(std::make_pair(low, v));
+                }
+            }
+        }
+        return true;
     }
 
-   private:
-    void addEdge(size_t u, size_t v, float w) {
-        adjacencies[u].push_back(std::make_pair(v, w));
-        adjacencies[v].push_back(std::make_pair(u, w));
+    // Inverts predecessors into a children list per vertex.
+    void buildChildren() {
+        size_t n = predecessors.size();
+        childOffsets.assign(n + 1, 0);
+        for (size_t v = 0; v < n; ++v) {
+            if (predecessors[v] != kNoPredecessor && predecessors[v] != v) ++childOffsets[predecessors[v] + 1];
+        }
+        for (size_t v = 0; v < n; ++v) childOffsets[v + 1] += childOffsets[v];
+        children.resize(childOffsets[n]);
+        // childOffsets[p] advances to the end of the children of p, then everything moves back by one
+        for (size_t v = 0; v < n; ++v) {
+            uint32_t p = predecessors[v];
+            if (p != kNoPredecessor && p != v) children[childOffsets[p]++] = v;
+        }
+        for (size_t v = n; v > 0; --v) childOffsets[v] = childOffsets[v - 1];
+        childOffsets[0] = 0;
     }
 
-    std::vector<std::vector<std::pair<size_t, float>>> adjacencies;
+    const EdgeGraph* graph;  // owned by mesh
+    std::vector<uint32_t> predecessors;
+    std::vector<float> distances;
+    std::vector<uint32_t> childOffsets, children, treeOrder;
+    int lastVertex;  // source of the last query, or -1 if it was lastPoint
+    SurfacePoint lastPoint;
+    Workspace workspace;  // for propagateInto(src, out)
 };
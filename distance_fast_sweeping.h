@@ -0,0 +1,241 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "DistanceAlgorithm.h"
+#include "parallel.h"
+
+// Fast sweeping eikonal solver on triangle meshes (Qian, Zhang & Zhao 2007). Vertices are visited in Gauss-Seidel
+// sweeps along precomputed orderings by reference directions, forwards and backwards, and lowered with the triangle
+// update of fast marching until a whole round changes nothing. There is no priority queue; every sweep walks its
+// order array and the per-corner update data linearly.
+//
+// With more than one thread the orderings run concurrently on private copies of the field, which are merged by a
+// minimum after every round (Detrixhe, Gibou & Min 2013). On one thread they run in place, one after another.
+//
+// It is slower than DijkstraAlgorithm, 10 to 15 times on one core for the models we ship, since every vertex is
+// updated about a dozen times over several rounds while the heap is not what limits Dijkstra on these meshes. What
+// it buys is accuracy: the result approximates the geodesic distance across faces instead of along edges. It needs
+// faces; on a point cloud every vertex but the source stays unreached.
+class FastSweepingAlgorithm : public DistanceAlgorithm {
+   public:
+    FastSweepingAlgorithm() : orders(), cornerOffsets(), corners(), tolerance(0.f), lastRounds(0) {}
+
+    void updatePositions(const float* positions) override final {
+        DistanceAlgorithm::updatePositions(positions);
+        prepare();
+    }
+
+    std::vector<float> propagate(int src) override final {
+        std::vector<std::pair<uint32_t, float>> seeds(1, std::make_pair(uint32_t(src), 0.f));
+        return solve(seeds);
+    }
+
+    // The corners of the face start at their exact straight-line distance to the point.
+    std::vector<float> propagate(const SurfacePoint& src) override final {
+        std::vector<std::pair<uint32_t, float>> seeds;
+        glm::vec3 p = position(src);
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = mesh->indices()[3 * src.face + k];
+            seeds.push_back(std::make_pair(v, glm::length(mesh->positions()[v] - p)));
+        }
+        return solve(seeds);
+    }
+
+    // Rounds of sweeps the last propagation needed to converge.
+    size_t getRounds() const { return lastRounds; }
+
+   private:
+    static const size_t kDirections = 4;
+    static const size_t kMaxRounds = 1000;
+
+    // One face around a vertex c: the other two corners a and b, the lengths of c-a and c-b, and the inverse Gram
+    // matrix Q of the edge vectors A = a - c and B = b - c (zero if the face is degenerate).
+    struct Corner {
+        uint32_t a, b;
+        float la, lb;
+        float q00, q01, q11;
+    };
+
+    void prepare() override final {
+        const std::vector<glm::vec3>& vertices = mesh->positions();
+        const std::vector<uint32_t>& faces = mesh->indices();
+        size_t n = vertices.size();
+        size_t numFaces = faces.size() / 3;
+
+        // vertex -> incident faces
+        cornerOffsets.assign(n + 1, 0);
+        for (size_t i = 0; i < faces.size(); ++i) ++cornerOffsets[faces[i] + 1];
+        for (size_t v = 0; v < n; ++v) cornerOffsets[v + 1] += cornerOffsets[v];
+        corners.resize(faces.size());
+        std::vector<uint32_t> fill(cornerOffsets.begin(), cornerOffsets.end() - 1);
+        for (size_t f = 0; f < numFaces; ++f) {
+            for (int k = 0; k < 3; ++k) {
+                uint32_t c = faces[3 * f + k];
+                Corner& corner = corners[fill[c]++];
+                corner.a = faces[3 * f + (k + 1) % 3];
+                corner.b = faces[3 * f + (k + 2) % 3];
+                glm::vec3 A = vertices[corner.a] - vertices[c];
+                glm::vec3 B = vertices[corner.b] - vertices[c];
+                corner.la = glm::length(A);
+                corner.lb = glm::length(B);
+                float aa = glm::dot(A, A), ab = glm::dot(A, B), bb = glm::dot(B, B);
+                float det = aa * bb - ab * ab;
+                bool degenerate = !(det > 1e-12f * aa * bb);
+                corner.q00 = degenerate ? 0.f : bb / det;
+                corner.q01 = degenerate ? 0.f : -ab / det;
+                corner.q11 = degenerate ? 0.f : aa / det;
+            }
+        }
+
+        // orderings by the projection on the diagonals of the bounding box; each is swept both ways
+        static const float directions[kDirections][3] = {{1, 1, 1}, {1, 1, -1}, {1, -1, 1}, {-1, 1, 1}};
+        orders.resize(kDirections);
+        parallelFor(kDirections, 1, [&](size_t begin, size_t end) {
+            std::vector<std::pair<float, uint32_t>> keys(n);
+            for (size_t d = begin; d < end; ++d) {
+                glm::vec3 dir(directions[d][0], directions[d][1], directions[d][2]);
+                for (size_t v = 0; v < n; ++v) keys[v] = std::make_pair(glm::dot(vertices[v], dir), uint32_t(v));
+                std::sort(keys.begin(), keys.end());
+                orders[d].resize(n);
+                for (size_t v = 0; v < n; ++v) orders[d][v] = keys[v].second;
+            }
+        });
+
+        std::vector<float> lengths;
+        for (size_t i = 0; i < corners.size(); ++i) lengths.push_back(corners[i].la);
+        float median = 0.f;
+        if (!lengths.empty()) {
+            std::nth_element(lengths.begin(), lengths.begin() + lengths.size() / 2, lengths.end());
+            median = lengths[lengths.size() / 2];
+        }
+        tolerance = 1e-5f * median;
+    }
+
+    // Smallest value at c from its incident faces: the planar wavefront through the corner values if it arrives
+    // from inside the face, otherwise along one of the two edges.
+    float update(uint32_t c, const float* T) const {
+        const float kInf = std::numeric_limits<float>::max();
+        float best = T[c];
+        for (uint32_t i = cornerOffsets[c]; i < cornerOffsets[c + 1]; ++i) {
+            const Corner& k = corners[i];
+            float ta = T[k.a], tb = T[k.b];
+            if (ta != kInf) best = std::min(best, ta + k.la);
+            if (tb != kInf) best = std::min(best, tb + k.lb);
+            if (ta == kInf || tb == kInf) continue;
+
+            // gradient g = alpha A + beta B with (alpha, beta) = Q (t - T), |g| = 1; solved relative to ta
+            float db = tb - ta;
+            float qa = k.q00 + 2.f * k.q01 + k.q11;
+            float qb = k.q01 * db + k.q11 * db;
+            float qc = k.q11 * db * db - 1.f;
+            float disc = qb * qb - qa * qc;
+            if (qa <= 0.f || disc < 0.f) continue;
+            float t = (qb + std::sqrt(disc)) / qa;
+            float alpha = -k.q00 * t + k.q01 * (db - t);
+            float beta = -k.q01 * t + k.q11 * (db - t);
+            if (alpha <= 0.f && beta <= 0.f) best = std::min(best, ta + t);  // upwind: -g points into the face
+        }
+        return best;
+    }
+
+    // Marks the vertices around c for another update.
+    void activateNeighbors(uint32_t c, char* active) const {
+        for (uint32_t i = cornerOffsets[c]; i < cornerOffsets[c + 1]; ++i) {
+            active[corners[i].a] = 1;
+            active[corners[i].b] = 1;
+        }
+    }
+
+    // Sweeps the order forwards or backwards, updating only active vertices (those next to one that was lowered by
+    // more than the tolerance since their last update). Returns whether any vertex was lowered that much.
+    bool sweep(const std::vector<uint32_t>& order, bool backwards, const std::vector<char>& fixed, float* T,
+               char* active) const {
+        bool changed = false;
+        size_t n = order.size();
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t c = order[backwards ? n - 1 - i : i];
+            if (!active[c]) continue;
+            active[c] = 0;
+            if (fixed[c]) continue;
+            float t = update(c, T);
+            if (t < T[c]) {
+                if (T[c] - t > tolerance) {
+                    changed = true;
+                    activateNeighbors(c, active);
+                }
+                T[c] = t;
+            }
+        }
+        return changed;
+    }
+
+    std::vector<float> solve(const std::vector<std::pair<uint32_t, float>>& seeds) {
+        size_t n = mesh->numVertices();
+        std::vector<float> T(n, std::numeric_limits<float>::max());
+        std::vector<char> fixed(n, 0), active(n, 0);
+        for (size_t i = 0; i < seeds.size(); ++i) {
+            T[seeds[i].first] = std::min(T[seeds[i].first], seeds[i].second);
+            fixed[seeds[i].first] = 1;
+            activateNeighbors(seeds[i].first, active.data());
+        }
+
+        lastRounds = 0;
+        if (numThreads() == 1) {
+            for (bool changed = true; changed && lastRounds < kMaxRounds; ++lastRounds) {
+                changed = false;
+                for (size_t d = 0; d < kDirections; ++d) {
+                    changed = sweep(orders[d], false, fixed, T.data(), active.data()) || changed;
+                    changed = sweep(orders[d], true, fixed, T.data(), active.data()) || changed;
+                }
+            }
+            return T;
+        }
+
+        // every copy starts from the merged field and active set; afterwards the neighbors of vertices lowered by
+        // any copy are active again
+        std::vector<std::vector<float>> copies(2 * kDirections);
+        std::vector<std::vector<char>> copyActive(copies.size());
+        for (bool changed = true; changed && lastRounds < kMaxRounds; ++lastRounds) {
+            std::vector<char> copyChanged(copies.size(), 0);
+            parallelFor(copies.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t s = begin; s < end; ++s) {
+                    copies[s] = T;
+                    copyActive[s] = active;
+                    copyChanged[s] = sweep(orders[s / 2], s % 2 == 1, fixed, copies[s].data(), copyActive[s].data());
+                }
+            });
+            changed = std::find(copyChanged.begin(), copyChanged.end(), 1) != copyChanged.end();
+
+            std::vector<char> lowered(n, 0);
+            parallelFor(n, 16384, [&](size_t begin, size_t end) {
+                for (size_t v = begin; v < end; ++v) {
+                    float t = T[v];
+                    for (size_t s = 0; s < copies.size(); ++s) t = std::min(t, copies[s][v]);
+                    lowered[v] = T[v] - t > tolerance;
+                    T[v] = t;
+                }
+            });
+            parallelFor(n, 16384, [&](size_t begin, size_t end) {
+                for (size_t c = begin; c < end; ++c) {
+                    active[c] = 0;
+                    for (uint32_t i = cornerOffsets[c]; i < cornerOffsets[c + 1] && !active[c]; ++i) {
+                        active[c] = lowered[corners[i].a] || lowered[corners[i].b];
+                    }
+                }
+            });
+        }
+        return T;
+    }
+
+    std::vector<std::vector<uint32_t>> orders;  // vertex orderings, one per reference direction
+    std::vector<uint32_t> cornerOffsets;        // corners of vertex c are [cornerOffsets[c], cornerOffsets[c + 1])
+    std::vector<Corner> corners;
+    float tolerance;  // smallest change that counts as progress
+    size_t lastRounds;
+};
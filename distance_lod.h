@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "DistanceAlgorithm.h"
+#include "mesh_lod.h"
+
+// Coarse-to-fine Dijkstra over a level of detail pyramid built when the mesh is loaded, see MeshLod::propagate().
+// With the default infinite radius every level is solved completely and the result equals DijkstraAlgorithm on the
+// finest level, at about twice its cost; only a finite radius, which re-solves finer levels near the source alone,
+// makes it faster. finestLevel > 0 stops early for a preview and is clamped to the coarsest level of the pyramid.
+class LodAlgorithm : public DistanceAlgorithm {
+   public:
+    explicit LodAlgorithm(float radius = std::numeric_limits<float>::max(), size_t finestLevel = 0)
+        : radius(radius), finestLevel(finestLevel), solvedLevel(0), lod() {}
+
+    // The pyramid refers to the positions of the mesh, so it is rebuilt.
+    void updatePositions(const float* positions) override final {
+        DistanceAlgorithm::updatePositions(positions);
+        prepare();
+    }
+
+    std::vector<float> propagate(int src) override final {
+        return lod.propagate(std::vector<std::pair<uint32_t, float>>(1, std::make_pair(uint32_t(src), 0.f)), radius,
+                             solvedLevel);
+    }
+
+    // The corners of the face start at their straight-line distance to the point.
+    std::vector<float> propagate(const SurfacePoint& src) override final {
+        std::vector<std::pair<uint32_t, float>> seeds;
+        glm::vec3 p = position(src);
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = mesh->indices()[3 * src.face + k];
+            seeds.push_back(std::make_pair(v, glm::length(mesh->positions()[v] - p)));
+        }
+        return lod.propagate(seeds, radius, solvedLevel);
+    }
+
+    const MeshLod& getLod() const { return lod; }
+    size_t getFinestLevel() const { return solvedLevel; }
+
+   private:
+    void prepare() override final {
+        lod.build(mesh->positions().data(), mesh->numVertices(), mesh->indices().data(), mesh->numFaces());
+        solvedLevel = std::min(finestLevel, lod.size() - 1);
+    }
+
+    float radius;        // of the band re-solved on the finest level
+    size_t finestLevel;  // 0 for full resolution
+    size_t solvedLevel;  // finestLevel within the pyramid
+    MeshLod lod;
+};
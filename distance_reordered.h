@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+
+#include "DistanceAlgorithm.h"
+#include "reorder.h"
+
+// Runs another algorithm on a copy of the mesh whose vertices are renumbered for memory locality, so its adjacency
+// walks and distance array accesses stay close together. Sources, targets and results use the original vertex ids;
+// face ids are unchanged.
+class ReorderedAlgorithm : public DistanceAlgorithm {
+   public:
+    ReorderedAlgorithm(DistanceAlgorithm* inner, VertexOrder method)
+        : inner(inner), method(method), order(), rank(), buffer(), field() {}
+
+    std::vector<float> propagate(int src) override final { return restore(inner->propagate(rank[src])); }
+
+    std::vector<float> propagate(const SurfacePoint& src) override final { return restore(inner->propagate(src)); }
+
+    void propagateInto(int src, float* out) override final {
+        field.resize(order.size());
+        inner->propagateInto(rank[src], field.data());
+        for (size_t i = 0; i < order.size(); ++i) out[order[i]] = field[i];
+    }
+
+    void updatePositions(const float* positions) override final {
+        DistanceAlgorithm::updatePositions(positions);
+        buffer.resize(3 * order.size());
+        permute(positions, buffer.data());
+        inner->updatePositions(buffer.data());
+    }
+
+    bool appendPath(uint32_t target, std::vector<uint32_t>& path) const override final {
+        size_t first = path.size();
+        if (!inner->appendPath(rank[target], path)) return false;
+        for (size_t i = first; i < path.size(); ++i) path[i] = order[path[i]];
+        return true;
+    }
+
+    // order[newId] = original id
+    const std::vector<uint32_t>& getOrder() const { return order; }
+
+   private:
+    void prepare() override final {
+        const std::vector<glm::vec3>& vertices = mesh->positions();
+        const std::vector<uint32_t>& faces = mesh->indices();
+        size_t n = vertices.size();
+
+        if (method == VERTEX_ORDER_MORTON) {
+            order = mortonOrder(vertices.data(), n);
+        } else if (method == VERTEX_ORDER_RCM && mesh->numFaces() == 0) {
+            order = reverseCuthillMcKeeOrder(mesh->graph());
+        } else if (method == VERTEX_ORDER_RCM) {
+            EdgeGraph graph;  // not the mesh's own, which would outlive the ordering unused
+            graph.build(n, faces.data(), faces.size() / 3, vertices.data());
+            order = reverseCuthillMcKeeOrder(graph);
+        } else {
+            order.resize(n);
+            for (size_t i = 0; i < n; ++i) order[i] = i;
+        }
+        rank.resize(n);
+        for (size_t i = 0; i < n; ++i) rank[order[i]] = i;
+
+        std::vector<glm::vec3> reorderedVertices(n);
+        for (size_t i = 0; i < n; ++i) reorderedVertices[i] = vertices[order[i]];
+        std::vector<uint32_t> reorderedFaces(faces.size());
+        for (size_t i = 0; i < faces.size(); ++i) reorderedFaces[i] = rank[faces[i]];
+        if (mesh->numFaces() == 0) {
+            // a point cloud's graph does not follow from faces, so it is renumbered along
+            EdgeGraph graph = renumber(mesh->graph(), reorderedVertices.data());
+            inner->load(std::make_shared<const Mesh>(std::move(reorderedVertices), std::move(reorderedFaces),
+                                                     std::move(graph)));
+        } else {
+            inner->load(std::make_shared<const Mesh>(std::move(reorderedVertices), std::move(reorderedFaces)));
+        }
+    }
+
+    EdgeGraph renumber(const EdgeGraph& graph, const glm::vec3* reorderedVertices) const {
+        EdgeGraph reordered;
+        reordered.offsets.assign(order.size() + 1, 0);
+        reordered.neighbors.reserve(graph.neighbors.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            for (uint32_t e = graph.offsets[order[i]]; e < graph.offsets[order[i] + 1]; ++e) {
+                reordered.neighbors.push_back(rank[graph.neighbors[e]]);
+            }
+            reordered.offsets[i + 1] = reordered.neighbors.size();
+            std::sort(reordered.neighbors.begin() + reordered.offsets[i], reordered.neighbors.end());
+        }
+        reordered.weights.resize(reordered.neighbors.size());
+        reordered.updateWeights(reorderedVertices);
+        return reordered;
+    }
+
+    void permute(const float* positions, float* reordered) const {
+        for (size_t i = 0; i < order.size(); ++i) {
+            for (int c = 0; c < 3; ++c) reordered[3 * i + c] = positions[3 * order[i] + c];
+        }
+    }
+
+    std::vector<float> restore(const std::vector<float>& reordered) const {
+        std::vector<float> dist(reordered.size());
+        for (size_t i = 0; i < order.size(); ++i) dist[order[i]] = reordered[i];
+        return dist;
+    }
+
+    std::unique_ptr<DistanceAlgorithm> inner;
+    VertexOrder method;
+    std::vector<uint32_t> order, rank;
+    std::vector<float> buffer;
+    std::vector<float> field;  // reordered result of propagateInto()
+};
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "DistanceAlgorithm.h"
+#include "parallel.h"
+
+// Dijkstra on the mesh refined with Steiner points (Lanthier, Maheshwari & Sack 2001): k points evenly spaced on every
+// edge, and within every face a straight segment between any two points on different sides. Paths may then cross
+// faces instead of following their edges, and the error shrinks as k grows, from that of the edge graph at k = 0
+// towards the exact geodesic distance.
+//
+// The refined graph is never stored. Node v < n is vertex v and node n + k * e + j is point j of edge e of
+// Mesh::edges(), at (j + 1) / (k + 1) of the way from its lower to its higher numbered vertex. Positions and edge
+// lengths are computed when a node is settled, from the faces around it, so the graph adds only the edge ids of every
+// face and the faces around every edge and vertex to the mesh. Those are built on the first propagation, in parallel
+// over the faces, and survive updatePositions().
+class SteinerAlgorithm : public DistanceAlgorithm {
+   public:
+    explicit SteinerAlgorithm(size_t pointsPerEdge = 3)
+        : k(pointsPerEdge),
+          built(false),
+          faceEdges(),
+          edgeFaceOffsets(),
+          edgeFaces(),
+          vertexFaceOffsets(),
+          vertexFaces(),
+          dist(),
+          heap() {}
+
+    std::vector<float> propagate(int src) override final {
+        std::vector<std::pair<uint32_t, float>> seeds(1, std::make_pair(uint32_t(src), 0.f));
+        return search(seeds);
+    }
+
+    // Every node on the boundary of the face starts at its straight-line distance to the point, which is exact
+    // inside the flat triangle.
+    std::vector<float> propagate(const SurfacePoint& src) override final {
+        build();
+        glm::vec3 p = position(src);
+        std::vector<std::pair<uint32_t, float>> seeds;
+        forFaceNodes(src.face, kNone, [&](uint32_t node, const glm::vec3& q) {
+            seeds.push_back(std::make_pair(node, glm::length(q - p)));
+        });
+        return search(seeds);
+    }
+
+    size_t getPointsPerEdge() const { return k; }
+
+    // Vertices and Steiner points of the refined graph.
+    size_t numNodes() const { return mesh->numVertices() + k * mesh->edges().size(); }
+
+   private:
+    static const uint32_t kNone = UINT32_MAX;
+    typedef std::pair<float, uint32_t> entry_t;  // distance, node
+
+    void prepare() override final {
+        built = false;
+        faceEdges.clear();
+        edgeFaceOffsets.clear();
+        edgeFaces.clear();
+        vertexFaceOffsets.clear();
+        vertexFaces.clear();
+    }
+
+    void build() {
+        if (built) return;
+        built = true;
+        const std::vector<uint32_t>& faces = mesh->indices();
+        const std::vector<std::pair<uint32_t, uint32_t>>& edges = mesh->edges();
+        size_t n = mesh->numVertices(), numFaces = mesh->numFaces();
+
+        // side i of face f runs from corner i to corner i + 1; kNone for degenerate sides
+        faceEdges.resize(3 * numFaces);
+        parallelFor(numFaces, 1024, [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                for (int i = 0; i < 3; ++i) {
+                    uint32_t a = faces[3 * f + i], b = faces[3 * f + (i + 1) % 3];
+                    std::pair<uint32_t, uint32_t> edge(std::min(a, b), std::max(a, b));
+                    auto it = std::lower_bound(edges.begin(), edges.end(), edge);
+                    faceEdges[3 * f + i] = it != edges.end() && *it == edge ? uint32_t(it - edges.begin()) : kNone;
+                }
+            }
+        });
+
+        edgeFaceOffsets.assign(edges.size() + 1, 0);
+        vertexFaceOffsets.assign(n + 1, 0);
+        for (size_t f = 0; f < numFaces; ++f) {
+            for (int i = 0; i < 3; ++i) {
+                if (faceEdges[3 * f + i] != kNone) ++edgeFaceOffsets[faceEdges[3 * f + i] + 1];
+                if (faces[3 * f + i] < n) ++vertexFaceOffsets[faces[3 * f + i] + 1];
+            }
+        }
+        for (size_t e = 0; e < edges.size(); ++e) edgeFaceOffsets[e + 1] += edgeFaceOffsets[e];
+        for (size_t v = 0; v < n; ++v) vertexFaceOffsets[v + 1] += vertexFaceOffsets[v];
+        edgeFaces.resize(edgeFaceOffsets.back());
+        vertexFaces.resize(vertexFaceOffsets.back());
+        std::vector<uint32_t> edgeFill(edgeFaceOffsets.begin(), edgeFaceOffsets.end() - 1);
+        std::vector<uint32_t> vertexFill(vertexFaceOffsets.begin(), vertexFaceOffsets.end() - 1);
+        for (size_t f = 0; f < numFaces; ++f) {
+            for (int i = 0; i < 3; ++i) {
+                if (faceEdges[3 * f + i] != kNone) edgeFaces[edgeFill[faceEdges[3 * f + i]]++] = f;
+                if (faces[3 * f + i] < n) vertexFaces[vertexFill[faces[3 * f + i]]++] = f;
+            }
+        }
+    }
+
+    // Point j of edge e is edge.first + (j + 1) * step; all positions are computed this way, so they agree exactly.
+    glm::vec3 step(const std::pair<uint32_t, uint32_t>& edge) const {
+        const std::vector<glm::vec3>& p = mesh->positions();
+        return (p[edge.second] - p[edge.first]) / float(k + 1);
+    }
+
+    glm::vec3 nodePosition(uint32_t node) const {
+        const std::vector<glm::vec3>& p = mesh->positions();
+        size_t n = p.size();
+        if (node < n) return p[node];
+        size_t e = (node - n) / k, j = (node - n) % k;
+        const std::pair<uint32_t, uint32_t>& edge = mesh->edges()[e];
+        return p[edge.first] + float(j + 1) * step(edge);
+    }
+
+    // Calls visit(node, position) for the Steiner points of edge e.
+    template <typename Visit>
+    void forEdgePoints(uint32_t e, Visit& visit) const {
+        const std::pair<uint32_t, uint32_t>& edge = mesh->edges()[e];
+        const glm::vec3& a = mesh->positions()[edge.first];
+        glm::vec3 d = step(edge);
+        uint32_t first = mesh->numVertices() + k * e;
+        for (uint32_t j = 0; j < k; ++j) visit(first + j, a + float(j + 1) * d);
+    }
+
+    // Calls visit(node, position) for the vertices and Steiner points on the boundary of face f, except those on edge
+    // skip.
+    template <typename Visit>
+    void forFaceNodes(uint32_t f, uint32_t skip, Visit visit) const {
+        const uint32_t* corners = &mesh->indices()[3 * f];
+        for (int i = 0; i < 3; ++i) {
+            uint32_t e = faceEdges[3 * f + i];
+            // corner i is on sides i and i - 1
+            if (skip == kNone || (e != skip && faceEdges[3 * f + (i + 2) % 3] != skip)) {
+                visit(corners[i], mesh->positions()[corners[i]]);
+            }
+            if (e != kNone && e != skip) forEdgePoints(e, visit);
+        }
+    }
+
+    std::vector<float> search(const std::vector<std::pair<uint32_t, float>>& seeds) {
+        build();
+        size_t n = mesh->numVertices();
+        const std::vector<std::pair<uint32_t, uint32_t>>& edges = mesh->edges();
+        dist.assign(numNodes(), std::numeric_limits<float>::max());
+        heap.clear();
+        for (size_t i = 0; i < seeds.size(); ++i) relax(seeds[i].first, seeds[i].second);
+
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<entry_t>());
+            entry_t top = heap.back();
+            heap.pop_back();
+            uint32_t u = top.second;
+            if (dist[u] != top.first) continue;  // stale entry
+            glm::vec3 pu = nodePosition(u);
+            auto visit = [&](uint32_t v, const glm::vec3& pv) {
+                if (dist[v] > top.first) relax(v, top.first + glm::length(pv - pu));  // settled ones cannot improve
+            };
+
+            if (u < n) {
+                // across every face around the vertex; the sides through u are reached along their edges
+                for (uint32_t i = vertexFaceOffsets[u]; i < vertexFaceOffsets[u + 1]; ++i) {
+                    uint32_t f = vertexFaces[i];
+                    const uint32_t* corners = &mesh->indices()[3 * f];
+                    int c = corners[0] == u ? 0 : corners[1] == u ? 1 : 2;
+                    uint32_t opposite = faceEdges[3 * f + (c + 1) % 3];
+                    if (opposite != kNone) forEdgePoints(opposite, visit);
+                    for (int s = 0; s < 3; s += 2) {  // the sides from u to corner c + 1 and from corner c + 2 to u
+                        uint32_t e = faceEdges[3 * f + (c + s) % 3];
+                        uint32_t other = corners[(c + 1 + s / 2) % 3];
+                        if (e == kNone || k == 0) {
+                            visit(other, mesh->positions()[other]);
+                        } else {
+                            uint32_t v = n + k * e + (u == edges[e].first ? 0 : k - 1);
+                            visit(v, nodePosition(v));
+                        }
+                    }
+                }
+            } else {
+                // along its own edge to the next node either way, then across the faces on both sides of it
+                uint32_t e = (u - n) / k, j = (u - n) % k;
+                uint32_t previous = j == 0 ? edges[e].first : u - 1, next = j == k - 1 ? edges[e].second : u + 1;
+                visit(previous, nodePosition(previous));
+                visit(next, nodePosition(next));
+                for (uint32_t i = edgeFaceOffsets[e]; i < edgeFaceOffsets[e + 1]; ++i) {
+                    forFaceNodes(edgeFaces[i], e, visit);
+                }
+            }
+        }
+        return std::vector<float>(dist.begin(), dist.begin() + n);
+    }
+
+    void relax(uint32_t v, float d) {
+        if (d < dist[v]) {
+            dist[v] = d;
+            heap.push_back(std::make_pair(d, v));
+            std::push_heap(heap.begin(), heap.end(), std::greater<entry_t>());
+        }
+    }
+
+    size_t k;    // Steiner points per edge
+    bool built;  // the tables below match the topology of mesh
+    std::vector<uint32_t> faceEdges;                        // three per face, see build()
+    std::vector<uint32_t> edgeFaceOffsets, edgeFaces;       // faces of edge e are [offsets[e], offsets[e + 1])
+    std::vector<uint32_t> vertexFaceOffsets, vertexFaces;  // faces around vertex v likewise
+    std::vector<float> dist;                                // per node
+    std::vector<entry_t> heap;
+};
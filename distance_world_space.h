@@ -1,37 +1,59 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <limits>
 #include <queue>
 #include <set>
 #include <utility>
 
+#include "DistanceAlgorithm.h"
+#include "kd_tree.h"
+
 class WorldSpaceAlgorithm : public DistanceAlgorithm {
    public:
-    WorldSpaceAlgorithm() : vertices() {}
-
-    void load(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes) override final {
-        size_t numVerts = attrib.vertices.size() / 3;
-        vertices.reserve(numVerts);
-
-        for (size_t i = 0; i < numVerts; ++i) {
-            glm::vec3 v;
-            for (int c = 0; c < 3; c++) {
-                v[0] = attrib.vertices[3 * i + 0];
-                v[1] = attrib.vertices[3 * i + 1];
-                v[2] = attrib.vertices[3 * i + 2];
-            }
-            vertices.push_back(v);
-        }
+    WorldSpaceAlgorithm() : tree() {}
+
+    void updatePositions(const float* positions) override final {
+        DistanceAlgorithm::updatePositions(positions);
+        prepare();
+    }
+
+    std::vector<float> propagate(int src) override final { return distancesFrom(mesh->positions()[src]); }
+
+    std::vector<float> propagate(const SurfacePoint& src) override final { return distancesFrom(position(src)); }
+
+    // Vertices at most radius from src with their distances, nearest first. Only the part of the KD-tree overlapping
+    // the ball is visited.
+    void distancesWithin(uint32_t src, float radius, std::vector<std::pair<uint32_t, float>>& out) const {
+        distancesWithin(mesh->positions()[src], radius, out);
+    }
+
+    void distancesWithin(const glm::vec3& center, float radius, std::vector<std::pair<uint32_t, float>>& out) const {
+        tree.within(center, radius, out);
+        std::sort(out.begin(), out.end(),
+                  [](const std::pair<uint32_t, float>& a, const std::pair<uint32_t, float>& b) {
+                      return a.second < b.second || (a.second == b.second && a.first < b.first);
+                  });
+    }
+
+    // The k vertices nearest to center with their distances, nearest first.
+    void nearest(const glm::vec3& center, size_t k, std::vector<std::pair<uint32_t, float>>& out) const {
+        tree.nearest(center, k, out);
     }
 
-    std::vector<float> propagate(int src) override final {
+    // Spatial index over the current positions, e.g. to restrict DijkstraAlgorithm::distancesWithin() to a ball.
+    const KdTree& getTree() const { return tree; }
+
+   private:
+    void prepare() override final { tree.build(mesh->positions().data(), mesh->numVertices()); }
+
+    std::vector<float> distancesFrom(const glm::vec3& v) const {
+        const std::vector<glm::vec3>& vertices = mesh->positions();
         std::vector<float> dist(vertices.size(), std::numeric_limits<float>::max());
-        const glm::vec3& v = vertices[src];
         for (size_t i = 0; i < vertices.size(); ++i) { dist[i] = glm::length(v - vertices[i]); }
         return dist;
     }
 
-   private:
-    std::vector<glm::vec3> vertices;
+    KdTree tree;
 };
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "parallel.h"
+
+// Edge graph of a triangle mesh in compressed sparse row form. Each undirected edge appears once in the row of
+// both of its endpoints, weighted by its length.
+struct EdgeGraph {
+    std::vector<uint32_t> offsets;  // row u is [offsets[u], offsets[u + 1])
+    std::vector<uint32_t> neighbors;
+    std::vector<float> weights;
+
+    size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+
+    void build(size_t numVertices, const uint32_t* faces, size_t numFaces, const glm::vec3* positions) {
+        offsets.assign(numVertices + 1, 0);
+        for (size_t i = 0; i < 3 * numFaces; ++i) offsets[faces[i] + 1] += 2;
+        for (size_t u = 0; u < numVertices; ++u) offsets[u + 1] += offsets[u];
+
+        neighbors.resize(offsets[numVertices]);
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t f = 0; f < numFaces; ++f) {
+            for (int k = 0; k < 3; ++k) {
+                uint32_t u = faces[3 * f + k];
+                neighbors[fill[u]++] = faces[3 * f + (k + 1) % 3];
+                neighbors[fill[u]++] = faces[3 * f + (k + 2) % 3];
+            }
+        }
+
+        // edges shared by two faces were added twice; sort and compact every row in place
+        uint32_t out = 0;
+        for (size_t u = 0; u < numVertices; ++u) {
+            uint32_t* first = neighbors.data() + offsets[u];
+            uint32_t* last = neighbors.data() + offsets[u + 1];
+            std::sort(first, last);
+            last = std::unique(first, last);
+            offsets[u] = out;
+            for (uint32_t* v = first; v != last; ++v) {
+                if (*v != u) neighbors[out++] = *v;
+            }
+        }
+        offsets[numVertices] = out;
+        neighbors.resize(out);
+        neighbors.shrink_to_fit();
+
+        weights.resize(out);
+        updateWeights(positions);
+    }
+
+    // Recomputes all edge lengths in place for new positions of the same vertices.
+    void updateWeights(const glm::vec3* positions) {
+        parallelFor(size(), 4096, [&](size_t begin, size_t end) {
+            const uint32_t* nbr = neighbors.data();
+            float* w = weights.data();
+            for (size_t u = begin; u < end; ++u) {
+                const float px = positions[u][0], py = positions[u][1], pz = positions[u][2];
+                for (uint32_t e = offsets[u]; e < offsets[u + 1]; ++e) {
+                    float dx = positions[nbr[e]][0] - px;
+                    float dy = positions[nbr[e]][1] - py;
+                    float dz = positions[nbr[e]][2] - pz;
+                    w[e] = std::sqrt(dx * dx + dy * dy + dz * dz);
+                }
+            }
+        });
+    }
+
+    // Weight of edge (u, v), which must exist.
+    float weight(uint32_t u, uint32_t v) const {
+        const uint32_t* first = neighbors.data() + offsets[u];
+        return weights[std::lower_bound(first, neighbors.data() + offsets[u + 1], v) - neighbors.data()];
+    }
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "edge_graph.h"
+#include "mesh.h"
+
+// Farthest-point sampling by edge graph distance: every new sample is the vertex farthest from all samples so far.
+// The distance to the nearest sample is kept per vertex and lowered by a search from each new sample, which expands
+// only the vertices it brings closer. A vertex already nearer to another sample is not expanded, and neither is
+// anything behind it, since the field is 1-Lipschitz along edges; so a sample costs in proportion to the part of the
+// mesh that changes hands, which shrinks as samples are added. An indexed max-heap over the field gives the next
+// farthest vertex and is updated only at lowered vertices.
+class FarthestPointSampler {
+   public:
+    static const uint32_t kNone = std::numeric_limits<uint32_t>::max();
+
+    FarthestPointSampler()
+        : mesh(std::make_shared<const Mesh>()), field(), owner(), heap(), slot(), queue(), samples(), visited(0) {}
+
+    // Starts over on mesh with no samples, all vertices infinitely far.
+    void reset(std::shared_ptr<const Mesh> sampled) {
+        mesh = std::move(sampled);
+        size_t n = mesh->numVertices();
+        field.assign(n, std::numeric_limits<float>::max());
+        owner.assign(n, uint32_t(kNone));
+        // all keys are equal, so vertices in id order already form a heap
+        heap.resize(n);
+        slot.resize(n);
+        for (size_t v = 0; v < n; ++v) heap[v] = slot[v] = v;
+        samples.clear();
+        visited = 0;
+    }
+
+    // Adds v as a sample and lowers the field around it.
+    void add(uint32_t v) {
+        const EdgeGraph& graph = mesh->graph();
+        uint32_t index = samples.size();
+        samples.push_back(v);
+        queue.clear();
+        lower(v, 0.f, index);
+        while (!queue.empty()) {
+            std::pop_heap(queue.begin(), queue.end(), std::greater<std::pair<float, uint32_t>>());
+            std::pair<float, uint32_t> top = queue.back();
+            queue.pop_back();
+            uint32_t u = top.second;
+            if (field[u] != top.first) continue;  // stale entry
+            ++visited;
+            for (uint32_t e = graph.offsets[u]; e < graph.offsets[u + 1]; ++e) {
+                float alt = top.first + graph.weights[e];
+                if (alt < field[graph.neighbors[e]]) lower(graph.neighbors[e], alt, index);
+            }
+        }
+    }
+
+    // Adds count samples: first, unless there are samples already, then each time the farthest vertex. Stops early
+    // once every vertex is a sample.
+    void sample(size_t count, uint32_t first = 0) {
+        for (size_t i = 0; i < count && samples.size() < field.size(); ++i) {
+            add(samples.empty() ? first : farthest());
+        }
+    }
+
+    // The vertex farthest from all samples, the lowest numbered among equals, and its distance to them: float max for
+    // a vertex no sample reaches.
+    uint32_t farthest() const { return heap.empty() ? uint32_t(kNone) : heap[0]; }
+    float coveringRadius() const { return heap.empty() ? 0.f : field[heap[0]]; }
+
+    const std::vector<uint32_t>& getSamples() const { return samples; }
+
+    // Distance from every vertex to its nearest sample.
+    const std::vector<float>& getDistances() const { return field; }
+
+    // Index in getSamples() of the nearest sample of every vertex, kNone if none reaches it. Vertices with the same
+    // nearest sample form its geodesic Voronoi cell.
+    const std::vector<uint32_t>& getNearest() const { return owner; }
+
+    // Vertices expanded by all searches so far, to compare with samples times vertices for full propagations.
+    size_t getVisited() const { return visited; }
+
+   private:
+    FarthestPointSampler(const FarthestPointSampler&);
+    FarthestPointSampler& operator=(const FarthestPointSampler&);
+
+    // Whether a belongs above b in the heap: farther, or as far and lower numbered.
+    bool above(uint32_t a, uint32_t b) const { return field[a] > field[b] || (field[a] == field[b] && a < b); }
+
+    void lower(uint32_t v, float d, uint32_t index) {
+        field[v] = d;
+        owner[v] = index;
+        queue.push_back(std::make_pair(d, v));
+        std::push_heap(queue.begin(), queue.end(), std::greater<std::pair<float, uint32_t>>());
+
+        // sift down, since the key only decreased
+        size_t i = slot[v];
+        for (;;) {
+            size_t child = 2 * i + 1;
+            if (child >= heap.size()) break;
+            if (child + 1 < heap.size() && above(heap[child + 1], heap[child])) ++child;
+            if (!above(heap[child], v)) break;
+            heap[i] = heap[child];
+            slot[heap[i]] = i;
+            i = child;
+        }
+        heap[i] = v;
+        slot[v] = i;
+    }
+
+    std::shared_ptr<const Mesh> mesh;
+    std::vector<float> field;     // distance to the nearest sample
+    std::vector<uint32_t> owner;  // index of the nearest sample
+    std::vector<uint32_t> heap;   // vertices, max-heap on field
+    std::vector<uint32_t> slot;   // position of every vertex in heap
+    std::vector<std::pair<float, uint32_t>> queue;  // search from the newest sample
+    std::vector<uint32_t> samples;
+    size_t visited;
+};
@@ -1,6 +1,8 @@
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <csignal>
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
@@ -15,14 +17,28 @@
 #include <GLFW/glfw3.h>
 #include <glm/gtx/normal.hpp>
 
+#include "bvh.h"
+#include "distance_delta_stepping.h"
 #include "distance_dijkstra.h"
+#include "distance_fast_sweeping.h"
+#include "distance_lod.h"
+#include "distance_reordered.h"
+#include "distance_steiner.h"
 #include "distance_world_space.h"
+#include "isolines.h"
 #include "math.h"
+#include "mesh_lod.h"
+#include "out_of_core.h"
+#include "point_cloud.h"
+#include "query_server.h"
 #include "trackball.h"
+#include "triangle_order.h"
+#include "weld.h"
 
 typedef struct {
-    std::vector<float> buffer;
+    std::vector<float> buffer;  // position, normal and color of every vertex
     GLuint vb_id;
+    GLuint ib_id;
     int numTriangles;
 } DrawObject;
 
@@ -34,13 +50,21 @@ typedef struct {
 
 float g_radius_mod = 1.0f;
 float g_radius = 1.f;
-std::vector<DrawObject> g_draw_objects;
+DrawObject g_draw_mesh;
+DrawObject g_draw_lod;  // index buffer of the current level of detail over the vertices of g_draw_mesh
 DrawPoints g_draw_points;
+DrawPoints g_draw_source;
+DrawPoints g_draw_path;
+DrawPoints g_draw_isolines;
 
-tinyobj::attrib_t g_attrib;
-std::vector<tinyobj::shape_t> g_shapes;
-glm::vec3 g_bmin, g_bmax;
+std::shared_ptr<const Mesh> g_mesh;  // shared with g_algorithm
 std::vector<float> g_distance;
+Bvh g_bvh;
+std::unique_ptr<DistanceAlgorithm> g_algorithm;
+glm::vec3 g_source_position;
+int g_target_vertex = -1;
+MeshLod g_lod;
+size_t g_lod_level = 0;
 
 int width = 768;
 int height = 768;
@@ -64,86 +88,58 @@ static void check_gl_errors(const std::string& desc) {
     }
 }
 
-static bool update_draw_objects(glm::vec3& bmin, glm::vec3& bmax, std::vector<DrawObject>& drawObjects,
-                                const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes) {
-    bmin[0] = bmin[1] = bmin[2] = std::numeric_limits<float>::max();
-    bmax[0] = bmax[1] = bmax[2] = -std::numeric_limits<float>::max();
-
-    for (size_t s = 0; s < shapes.size(); s++) {
-        DrawObject& o = drawObjects[s];
-        o.buffer.resize((3 + 3 + 3) * shapes[s].mesh.indices.size());
-        size_t b = 0;
-
-        for (size_t f = 0; f < shapes[s].mesh.indices.size() / 3; f++) {
-            tinyobj::index_t idx0 = shapes[s].mesh.indices[3 * f + 0];
-            tinyobj::index_t idx1 = shapes[s].mesh.indices[3 * f + 1];
-            tinyobj::index_t idx2 = shapes[s].mesh.indices[3 * f + 2];
-
-            glm::vec3 v[3];
-            for (int k = 0; k < 3; k++) {
-                int f0 = idx0.vertex_index;
-                int f1 = idx1.vertex_index;
-                int f2 = idx2.vertex_index;
-                assert(f0 >= 0);
-                assert(f1 >= 0);
-                assert(f2 >= 0);
-
-                v[0][k] = attrib.vertices[3 * f0 + k];
-                v[1][k] = attrib.vertices[3 * f1 + k];
-                v[2][k] = attrib.vertices[3 * f2 + k];
-                bmin[k] = std::min(v[0][k], bmin[k]);
-                bmin[k] = std::min(v[1][k], bmin[k]);
-                bmin[k] = std::min(v[2][k], bmin[k]);
-                bmax[k] = std::max(v[0][k], bmax[k]);
-                bmax[k] = std::max(v[1][k], bmax[k]);
-                bmax[k] = std::max(v[2][k], bmax[k]);
-            }
-
-            glm::vec3 n[3];
-            n[0] = n[1] = n[2] = glm::triangleNormal(v[0], v[1], v[2]);
-
-            for (int k = 0; k < 3; k++) {
-                o.buffer[b++] = v[k][0];
-                o.buffer[b++] = v[k][1];
-                o.buffer[b++] = v[k][2];
-                o.buffer[b++] = n[k][0];
-                o.buffer[b++] = n[k][1];
-                o.buffer[b++] = n[k][2];
-
-                glm::vec3 diffuse{1.0f, 0.0f, 0.0f};
-                float dist = g_distance[shapes[s].mesh.indices[3 * f + k].vertex_index];
-                dist = (g_radius - dist) / g_radius;
-                dist = std::max(dist, 0.f);
-                glm::vec3 color = dist * diffuse;
-                o.buffer[b++] = color[0];
-                o.buffer[b++] = color[1];
-                o.buffer[b++] = color[2];
-            }
-        }
+// Colors fade from red at the source to black at g_radius. The index buffer is uploaded once; later calls only
+// refresh the vertices. A point cloud has no index buffer and is drawn as points.
+static void update_draw_objects(DrawObject& o, const Mesh& mesh) {
+    const std::vector<glm::vec3>& positions = mesh.positions();
+    const std::vector<uint32_t>& indices = mesh.indices();
+    const std::vector<glm::vec3>& faceNormals = mesh.faceNormals();
+    std::vector<glm::vec3> normals(positions.size(), glm::vec3(0.f));
+    for (size_t i = 0; i < indices.size(); i++) normals[indices[i]] += faceNormals[i / 3];
 
-        o.vb_id = 0;
-        o.numTriangles = 0;
+    o.buffer.resize((3 + 3 + 3) * positions.size());
+    size_t b = 0;
+    for (size_t v = 0; v < positions.size(); v++) {
+        glm::vec3 n = glm::length(normals[v]) > 0.f ? glm::normalize(normals[v]) : normals[v];
+        float dist = std::max((g_radius - g_distance[v]) / g_radius, 0.f);
+        float vertex[9] = {positions[v][0], positions[v][1], positions[v][2], n[0], n[1], n[2], dist, 0.f, 0.f};
+        for (int c = 0; c < 9; c++) o.buffer[b++] = vertex[c];
+    }
 
-        if (o.buffer.size() > 0) {
-            glGenBuffers(1, &o.vb_id);
-            glBindBuffer(GL_ARRAY_BUFFER, o.vb_id);
-            glBufferData(GL_ARRAY_BUFFER, o.buffer.size() * sizeof(float), &o.buffer.at(0), GL_STATIC_DRAW);
-            o.numTriangles = o.buffer.size() / (3 + 3 + 3) / 3;
-        }
+    o.numTriangles = indices.size() / 3;
+    if (o.buffer.empty()) return;
+    if (o.vb_id == 0) glGenBuffers(1, &o.vb_id);
+    glBindBuffer(GL_ARRAY_BUFFER, o.vb_id);
+    glBufferData(GL_ARRAY_BUFFER, o.buffer.size() * sizeof(float), &o.buffer.at(0), GL_DYNAMIC_DRAW);
+    if (o.ib_id == 0 && !indices.empty()) {
+        glGenBuffers(1, &o.ib_id);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, o.ib_id);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), &indices.at(0), GL_STATIC_DRAW);
     }
+}
 
-    return true;
+// Triangles of the current level of detail, drawn over the vertices of the full mesh.
+void update_draw_lod() {
+    if (g_lod_level == 0) return;
+    const std::vector<uint32_t>& indices = g_lod.level(g_lod_level).indices;
+    g_draw_lod.vb_id = g_draw_mesh.vb_id;
+    g_draw_lod.numTriangles = indices.size() / 3;
+    if (indices.empty()) return;
+    if (g_draw_lod.ib_id == 0) glGenBuffers(1, &g_draw_lod.ib_id);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_draw_lod.ib_id);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), &indices.at(0), GL_DYNAMIC_DRAW);
 }
 
-void update_draw_points(const tinyobj::attrib_t& attrib) {
+void update_draw_points(const Mesh& mesh) {
+    const std::vector<glm::vec3>& positions = mesh.positions();
     g_draw_points.buffer.resize(g_distance.size() * 3);
     size_t b = 0;
     g_draw_points.numPoints = 0;
     for (size_t i = 0; i < g_distance.size(); ++i) {
         if (g_distance[i] <= g_radius) {
-            g_draw_points.buffer[b++] = attrib.vertices[3 * i + 0];
-            g_draw_points.buffer[b++] = attrib.vertices[3 * i + 1];
-            g_draw_points.buffer[b++] = attrib.vertices[3 * i + 2];
+            g_draw_points.buffer[b++] = positions[i][0];
+            g_draw_points.buffer[b++] = positions[i][1];
+            g_draw_points.buffer[b++] = positions[i][2];
             ++g_draw_points.numPoints;
         }
     }
@@ -155,6 +151,114 @@ void update_draw_points(const tinyobj::attrib_t& attrib) {
     }
 }
 
+void update_draw_isolines() {
+    std::vector<float> isovalues(1, g_radius);
+    extractIsolines(reinterpret_cast<const float*>(g_mesh->positions().data()), g_mesh->indices().data(),
+                    g_mesh->numFaces(), g_distance.data(), isovalues, g_draw_isolines.buffer);
+    g_draw_isolines.numPoints = g_draw_isolines.buffer.size() / 3;
+    if (g_draw_isolines.numPoints == 0) return;
+
+    if (g_draw_isolines.vb_id == 0) glGenBuffers(1, &g_draw_isolines.vb_id);
+    glBindBuffer(GL_ARRAY_BUFFER, g_draw_isolines.vb_id);
+    glBufferData(GL_ARRAY_BUFFER, g_draw_isolines.buffer.size() * sizeof(float), &g_draw_isolines.buffer.at(0),
+                 GL_DYNAMIC_DRAW);
+}
+
+void update_draw_source(const glm::vec3& src) {
+    std::vector<float> buffer;
+    buffer.push_back(src[0]);
+    buffer.push_back(src[1]);
+    buffer.push_back(src[2]);
+    if (g_draw_source.vb_id == 0) glGenBuffers(1, &g_draw_source.vb_id);
+    glBindBuffer(GL_ARRAY_BUFFER, g_draw_source.vb_id);
+    glBufferData(GL_ARRAY_BUFFER, buffer.size() * sizeof(float), &buffer.at(0), GL_STATIC_DRAW);
+    g_draw_source.numPoints = buffer.size() / 3;
+}
+
+// Line strip from the source point along the shortest path tree to the target vertex.
+void update_draw_path() {
+    g_draw_path.numPoints = 0;
+    if (g_target_vertex < 0) return;
+    std::vector<uint32_t> path = g_algorithm->path(g_target_vertex);
+    if (path.empty()) return;
+
+    g_draw_path.buffer.clear();
+    for (int k = 0; k < 3; k++) g_draw_path.buffer.push_back(g_source_position[k]);
+    for (size_t i = 0; i < path.size(); ++i) {
+        for (int k = 0; k < 3; k++) g_draw_path.buffer.push_back(g_mesh->positions()[path[i]][k]);
+    }
+    if (g_draw_path.vb_id == 0) glGenBuffers(1, &g_draw_path.vb_id);
+    glBindBuffer(GL_ARRAY_BUFFER, g_draw_path.vb_id);
+    glBufferData(GL_ARRAY_BUFFER, g_draw_path.buffer.size() * sizeof(float), &g_draw_path.buffer.at(0),
+                 GL_STATIC_DRAW);
+    g_draw_path.numPoints = g_draw_path.buffer.size() / 3;
+}
+
+static void set_source(const SurfacePoint& src) {
+    g_distance = g_algorithm->propagate(src);
+    g_source_position = g_algorithm->position(src);
+    update_draw_source(g_source_position);
+    update_draw_path();
+    update_draw_isolines();
+    update_draw_points(*g_mesh);
+    update_draw_objects(g_draw_mesh, *g_mesh);
+}
+
+// Casts a ray through the given window position using the matrices of the last frame.
+static bool pick_surface_point(double mouse_x, double mouse_y, SurfacePoint& picked) {
+    GLdouble model[16], proj[16];
+    GLint viewport[4];
+    glGetDoublev(GL_MODELVIEW_MATRIX, model);
+    glGetDoublev(GL_PROJECTION_MATRIX, proj);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // window coordinates may differ from framebuffer pixels on high-dpi displays
+    double x = mouse_x * viewport[2] / width;
+    double y = viewport[3] - mouse_y * viewport[3] / height;
+    GLdouble p_near[3], p_far[3];
+    gluUnProject(x, y, 0.0, model, proj, viewport, &p_near[0], &p_near[1], &p_near[2]);
+    gluUnProject(x, y, 1.0, model, proj, viewport, &p_far[0], &p_far[1], &p_far[2]);
+
+    glm::vec3 origin(p_near[0], p_near[1], p_near[2]);
+    glm::vec3 dir = glm::vec3(p_far[0], p_far[1], p_far[2]) - origin;
+    RayHit hit;
+    if (!g_bvh.intersect(origin, dir, hit)) return false;
+
+    picked.face = hit.face;
+    picked.u = hit.u;
+    picked.v = hit.v;
+    return true;
+}
+
+// Reorders the triangles of every shape for vertex cache reuse and less overdraw.
+static void optimize_triangle_order(const tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes) {
+    std::vector<glm::vec3> positions(attrib.vertices.size() / 3);
+    for (size_t i = 0; i < positions.size(); i++) {
+        positions[i] = glm::vec3(attrib.vertices[3 * i + 0], attrib.vertices[3 * i + 1], attrib.vertices[3 * i + 2]);
+    }
+
+    for (size_t s = 0; s < shapes.size(); s++) {
+        tinyobj::mesh_t& mesh = shapes[s].mesh;
+        size_t numFaces = mesh.indices.size() / 3;
+        std::vector<uint32_t> indices(3 * numFaces);
+        for (size_t i = 0; i < indices.size(); i++) indices[i] = mesh.indices[i].vertex_index;
+        std::vector<uint32_t> order =
+            optimizeTriangleOrder(indices.data(), numFaces, positions.data(), positions.size());
+
+        tinyobj::mesh_t reordered = mesh;
+        for (size_t f = 0; f < numFaces; f++) {
+            for (int k = 0; k < 3; k++) reordered.indices[3 * f + k] = mesh.indices[3 * order[f] + k];
+            if (mesh.material_ids.size() == numFaces) reordered.material_ids[f] = mesh.material_ids[order[f]];
+            if (mesh.smoothing_group_ids.size() == numFaces) {
+                reordered.smoothing_group_ids[f] = mesh.smoothing_group_ids[order[f]];
+            }
+        }
+        mesh.indices.swap(reordered.indices);
+        mesh.material_ids.swap(reordered.material_ids);
+        mesh.smoothing_group_ids.swap(reordered.smoothing_group_ids);
+    }
+}
+
 static void window_size_callback(GLFWwindow* window, int w, int h) {
     int fb_w, fb_h;
     glfwGetFramebufferSize(window, &fb_w, &fb_h);
@@ -185,8 +289,31 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 }
 
 static void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
-    (void)window;
-    (void)mods;
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS && (mods & GLFW_MOD_CONTROL)) {
+        double mouse_x, mouse_y;
+        glfwGetCursorPos(window, &mouse_x, &mouse_y);
+        SurfacePoint picked;
+        if (pick_surface_point(mouse_x, mouse_y, picked)) {
+            printf("source: face %u (%f, %f)\n", picked.face, picked.u, picked.v);
+            set_source(picked);
+        }
+        return;
+    }
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS && (mods & GLFW_MOD_ALT)) {
+        double mouse_x, mouse_y;
+        glfwGetCursorPos(window, &mouse_x, &mouse_y);
+        SurfacePoint picked;
+        if (pick_surface_point(mouse_x, mouse_y, picked)) {
+            // snap to the corner with the largest barycentric weight
+            int corner = 0;
+            if (picked.u > 1.f - picked.u - picked.v) corner = 1;
+            if (picked.v > std::max(picked.u, 1.f - picked.u - picked.v)) corner = 2;
+            g_target_vertex = g_mesh->indices()[3 * picked.face + corner];
+            printf("target: %d (%f)\n", g_target_vertex, g_distance[g_target_vertex]);
+            update_draw_path();
+        }
+        return;
+    }
     if (button == GLFW_MOUSE_BUTTON_LEFT) {
         if (action == GLFW_PRESS) {
             mouseLeftPressed = true;
@@ -218,8 +345,9 @@ static void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     } else {
         g_radius += yoffset * g_radius_mod;
         printf("radius: %f\n", g_radius);
-        update_draw_points(g_attrib);
-        update_draw_objects(g_bmin, g_bmax, g_draw_objects, g_attrib, g_shapes);
+        update_draw_points(*g_mesh);
+        update_draw_objects(g_draw_mesh, *g_mesh);
+        update_draw_isolines();
     }
 }
 
@@ -249,8 +377,26 @@ static void cursor_pos_callback(GLFWwindow* window, double mouse_x, double mouse
     prevMouseY = mouse_y;
 }
 
-static void draw(const std::vector<DrawObject>& drawObjects) {
+static void draw(const DrawObject& o) {
     GLsizei stride = (3 + 3 + 3) * sizeof(float);
+    if (o.vb_id < 1) return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, o.vb_id);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, (const void*)0);
+    glNormalPointer(GL_FLOAT, stride, (const void*)(sizeof(float) * 3));
+    glColorPointer(3, GL_FLOAT, stride, (const void*)(sizeof(float) * 6));
+
+    if (o.ib_id < 1) {  // point cloud
+        glEnableClientState(GL_COLOR_ARRAY);
+        glPointSize(3.f);
+        glDrawArrays(GL_POINTS, 0, o.buffer.size() / (3 + 3 + 3));
+        check_gl_errors("drawarrays");
+        glDisableClientState(GL_COLOR_ARRAY);
+        return;
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, o.ib_id);
 
     // draw mesh
     glPolygonMode(GL_FRONT, GL_FILL);
@@ -258,22 +404,9 @@ static void draw(const std::vector<DrawObject>& drawObjects) {
 
     glEnable(GL_POLYGON_OFFSET_FILL);
     glPolygonOffset(1.0, 100.0);
-    for (size_t i = 0; i < drawObjects.size(); i++) {
-        DrawObject o = drawObjects[i];
-        if (o.vb_id < 1) { continue; }
-
-        glBindBuffer(GL_ARRAY_BUFFER, o.vb_id);
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glEnableClientState(GL_NORMAL_ARRAY);
-        glEnableClientState(GL_COLOR_ARRAY);
-
-        glVertexPointer(3, GL_FLOAT, stride, (const void*)0);
-        glNormalPointer(GL_FLOAT, stride, (const void*)(sizeof(float) * 3));
-        glColorPointer(3, GL_FLOAT, stride, (const void*)(sizeof(float) * 6));
-
-        glDrawArrays(GL_TRIANGLES, 0, 3 * o.numTriangles);
-        check_gl_errors("drawarrays");
-    }
+    glEnableClientState(GL_COLOR_ARRAY);
+    glDrawElements(GL_TRIANGLES, 3 * o.numTriangles, GL_UNSIGNED_INT, (const void*)0);
+    check_gl_errors("drawelements");
 
     // draw wireframe
     glDisable(GL_POLYGON_OFFSET_FILL);
@@ -283,21 +416,9 @@ static void draw(const std::vector<DrawObject>& drawObjects) {
 
     glPolygonOffset(1.0, 10.0);
     glColor3f(0.2f, 0.2f, 0.25f);
-    for (size_t i = 0; i < drawObjects.size(); i++) {
-        DrawObject o = drawObjects[i];
-        if (o.vb_id < 1) { continue; }
-
-        glBindBuffer(GL_ARRAY_BUFFER, o.vb_id);
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glEnableClientState(GL_NORMAL_ARRAY);
-        glDisableClientState(GL_COLOR_ARRAY);
-        glVertexPointer(3, GL_FLOAT, stride, (const void*)0);
-        glNormalPointer(GL_FLOAT, stride, (const void*)(sizeof(float) * 3));
-        glColorPointer(3, GL_FLOAT, stride, (const void*)(sizeof(float) * 6));
-
-        glDrawArrays(GL_TRIANGLES, 0, 3 * o.numTriangles);
-        check_gl_errors("drawarrays");
-    }
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDrawElements(GL_TRIANGLES, 3 * o.numTriangles, GL_UNSIGNED_INT, (const void*)0);
+    check_gl_errors("drawelements");
 
     // draw vertices
     glDisable(GL_POLYGON_OFFSET_LINE);
@@ -308,21 +429,9 @@ static void draw(const std::vector<DrawObject>& drawObjects) {
     glPolygonOffset(1.0, 1.0);
     glColor3f(0.4f, 0.4f, 0.4f);
     glPointSize(2.f);
-    for (size_t i = 0; i < drawObjects.size(); i++) {
-        DrawObject o = drawObjects[i];
-        if (o.vb_id < 1) { continue; }
-
-        glBindBuffer(GL_ARRAY_BUFFER, o.vb_id);
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glEnableClientState(GL_NORMAL_ARRAY);
-        glDisableClientState(GL_COLOR_ARRAY);
-        glVertexPointer(3, GL_FLOAT, stride, (const void*)0);
-        glNormalPointer(GL_FLOAT, stride, (const void*)(sizeof(float) * 3));
-        glColorPointer(3, GL_FLOAT, stride, (const void*)(sizeof(float) * 6));
-
-        glDrawArrays(GL_TRIANGLES, 0, 3 * o.numTriangles);
-        check_gl_errors("drawarrays");
-    }
+    glDrawElements(GL_TRIANGLES, 3 * o.numTriangles, GL_UNSIGNED_INT, (const void*)0);
+    check_gl_errors("drawelements");
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 static void draw(const DrawPoints& drawPoints, float color[3]) {
@@ -345,6 +454,17 @@ static void draw(const DrawPoints& drawPoints, float color[3]) {
     }
 }
 
+static void draw_lines(const DrawPoints& drawPoints, GLenum mode, float color[3]) {
+    glColor3f(color[0], color[1], color[2]);
+    glLineWidth(2.f);
+    glBindBuffer(GL_ARRAY_BUFFER, drawPoints.vb_id);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 3 * sizeof(float), (const void*)0);
+
+    glDrawArrays(mode, 0, drawPoints.numPoints);
+    check_gl_errors("drawarrays");
+}
+
 static void init() {
     trackball(curr_quat, 0, 0, 0, 0);
 
@@ -361,6 +481,96 @@ static void init() {
     up[2] = 0.0f;
 }
 
+// Propagates from one vertex without loading the mesh into memory or opening a window. The graph file is written
+// next to the OBJ file on first use.
+static int runOutOfCore(const std::string& obj, int source, size_t budgetMB) {
+    typedef std::chrono::steady_clock Clock;
+    std::string path = obj + ".ooc";
+    OutOfCoreMesh mesh;
+    if (!mesh.open(path, budgetMB << 20)) {
+        Clock::time_point start = Clock::now();
+        if (!OutOfCoreMesh::preprocess(obj, path) || !mesh.open(path, budgetMB << 20)) {
+            std::cerr << "Failed to preprocess " << obj << std::endl;
+            return 1;
+        }
+        printf("preprocess: %.3f s\n", std::chrono::duration<double>(Clock::now() - start).count());
+    }
+    if (source < 0 || size_t(source) >= mesh.size()) {
+        std::cerr << "Source vertex out of range" << std::endl;
+        return 1;
+    }
+    printf("%zu vertices, %zu partitions, %zu boundary vertices\n", mesh.size(), mesh.getNumPartitions(),
+           mesh.getNumBoundary());
+
+    Clock::time_point start = Clock::now();
+    std::vector<float> distance = mesh.propagate(source);
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    if (distance.empty()) {
+        std::cerr << "Failed to map a partition of " << path << std::endl;
+        return 1;
+    }
+    float farthest = 0.f;
+    for (size_t v = 0; v < distance.size(); ++v) {
+        if (distance[v] != std::numeric_limits<float>::max()) farthest = std::max(farthest, distance[v]);
+    }
+
+    const OutOfCoreMesh::Stats& stats = mesh.getStats();
+    printf("propagate: %.3f s, farthest %f, %.2f scans per vertex\n", elapsed, farthest,
+           double(stats.settled) / std::max<size_t>(mesh.size(), 1));
+    printf("partitions: %zu loads, %zu evictions, %.1f MB paged in, %.1f MB peak resident (budget %zu MB)\n",
+           stats.loads, stats.evictions, stats.bytesPaged / 1048576.0, stats.peakResident / 1048576.0, budgetMB);
+    printf("process: %.1f MB peak RSS, %.1f MB read from storage\n", stats.peakRss / 1048576.0,
+           stats.blocksRead * 512 / 1048576.0);
+    return 0;
+}
+
+static QueryServer* g_server = nullptr;
+
+static void stopServer(int) {
+    if (g_server) g_server->stop();
+}
+
+// Loads the meshes, numbered in the given order, and answers queries on the socket until interrupted. Files without
+// faces are served as point clouds over their k-nearest-neighbor graphs.
+static int runServer(const std::vector<std::string>& objs, const std::string& socketPath, size_t knn, float maxSine) {
+    QueryServer server;
+    for (size_t i = 0; i < objs.size(); ++i) {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::string err;
+        if (!tinyobj::LoadObj(&attrib, &shapes, nullptr, &err, objs[i].c_str())) {
+            std::cerr << "Failed to load " << objs[i] << ": " << err << std::endl;
+            return 1;
+        }
+        std::shared_ptr<const Mesh> loaded = Mesh::fromObj(attrib, shapes);
+        if (loaded->numFaces() == 0) loaded = pointCloudMesh(*loaded, knn, maxSine);
+        std::unique_ptr<DijkstraAlgorithm> mesh(new DijkstraAlgorithm());
+        mesh->load(loaded);
+        printf("mesh %u: %s, %zu vertices\n", server.addMesh(std::move(mesh)), objs[i].c_str(),
+               attrib.vertices.size() / 3);
+    }
+    if (!server.listen(socketPath)) {
+        std::cerr << "Failed to listen on " << socketPath << std::endl;
+        return 1;
+    }
+
+    g_server = &server;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    printf("serving on %s\n", socketPath.c_str());
+    server.run();
+    g_server = nullptr;
+
+    static const char* names[QUERY_TYPES] = {"single source", "multi source", "bounded", "point to point", "stats"};
+    for (size_t t = 0; t < QUERY_TYPES; ++t) {
+        LatencyHistogram h = server.histogram(QueryType(t));
+        if (h.count == 0) continue;
+        printf("%s: %llu requests, mean %.0f us\n", names[t], (unsigned long long)h.count,
+               double(h.totalMicroseconds) / h.count);
+    }
+    return 0;
+}
+
 int main(int argc, char** argv) {
     if (argc < 2) {
         std::cout << "Needs input.obj\n" << std::endl;
@@ -370,6 +580,10 @@ int main(int argc, char** argv) {
     enum Algorithm {
         WORLD_SPACE,
         DIJKSTRA,
+        DELTA_STEPPING,
+        FAST_SWEEPING,
+        STEINER,
+        LOD,
     };
     Algorithm alg = WORLD_SPACE;
     if (argc >= 3) {
@@ -377,10 +591,64 @@ int main(int argc, char** argv) {
         switch (m) {
             case 0: alg = WORLD_SPACE; break;
             case 1: alg = DIJKSTRA; break;
+            case 2: alg = DELTA_STEPPING; break;
+            case 3: alg = FAST_SWEEPING; break;
+            case 4: alg = STEINER; break;
+            case 5: alg = LOD; break;
             default: std::cout << "unrecognized algorithm selection, defaulting to Dijkstra's" << std::endl; break;
         }
     }
 
+    VertexOrder vertex_order = VERTEX_ORDER_NONE;
+    bool optimize_triangles = false;
+    bool lod = false;
+    float weld_epsilon = -1.f;  // relative to the bounding box diagonal if 0, no welding if negative
+    size_t knn = 8;             // neighbors per point of a point cloud
+    size_t steiner_points = 3;  // per edge for the Steiner graph
+    float lod_radius = 0.1f;    // of the coarse-to-fine band relative to the bounding box diagonal, exact if negative
+    size_t lod_finest = 0;      // finest level solved coarse-to-fine
+    float tangent_sine = 1.f;   // sine of the largest angle of a point cloud edge to the tangent planes
+    size_t out_of_core_budget = 0;  // MB, 0 for the interactive viewer
+    int source = 0;
+    std::string socket_path;
+    std::vector<std::string> served(1, argv[1]);
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string value = arg.substr(arg.find('=') + 1);
+        if (arg.compare(0, 15, "--vertex-order=") == 0) {
+            if (!parseVertexOrder(value, vertex_order)) std::cout << "unrecognized vertex order " << value << std::endl;
+        } else if (arg == "--optimize-triangles") {
+            optimize_triangles = true;
+        } else if (arg == "--lod") {
+            lod = true;
+        } else if (arg == "--weld" || arg.compare(0, 7, "--weld=") == 0) {
+            weld_epsilon = arg.find('=') == std::string::npos ? 0.f : std::max(float(atof(value.c_str())), 0.f);
+        } else if (arg.compare(0, 17, "--steiner-points=") == 0) {
+            steiner_points = std::max(atoi(value.c_str()), 0);
+        } else if (arg.compare(0, 13, "--lod-radius=") == 0) {
+            lod_radius = float(atof(value.c_str()));
+        } else if (arg.compare(0, 12, "--lod-level=") == 0) {
+            lod_finest = std::max(atoi(value.c_str()), 0);
+        } else if (arg.compare(0, 6, "--knn=") == 0) {
+            knn = std::max(atoi(value.c_str()), 1);
+        } else if (arg.compare(0, 16, "--tangent-angle=") == 0) {
+            tangent_sine = std::sin(std::min(std::max(float(atof(value.c_str())), 0.f), 90.f) * float(M_PI) / 180.f);
+        } else if (arg == "--out-of-core" || arg.compare(0, 14, "--out-of-core=") == 0) {
+            out_of_core_budget = arg.find('=') == std::string::npos ? 256 : std::max(atoi(value.c_str()), 1);
+        } else if (arg.compare(0, 9, "--source=") == 0) {
+            source = atoi(value.c_str());
+        } else if (arg.compare(0, 8, "--serve=") == 0) {
+            socket_path = value;
+        } else if (arg.compare(0, 7, "--mesh=") == 0) {
+            served.push_back(value);
+        } else {
+            std::cout << "unrecognized option " << arg << std::endl;
+        }
+    }
+
+    if (out_of_core_budget > 0) return runOutOfCore(argv[1], source, out_of_core_budget);
+    if (!socket_path.empty()) return runServer(served, socket_path, knn, tangent_sine);
+
     init();
 
     if (!glfwInit()) {
@@ -412,17 +680,65 @@ int main(int argc, char** argv) {
 
     window_size_callback(window, width, height);
 
-    std::string err;
-    if (!tinyobj::LoadObj(&g_attrib, &g_shapes, nullptr, &err, argv[1])) {
-        if (!err.empty()) { std::cerr << err << std::endl; }
-        glfwTerminate();
-        return -1;
+    {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::string err;
+        if (!tinyobj::LoadObj(&attrib, &shapes, nullptr, &err, argv[1])) {
+            if (!err.empty()) { std::cerr << err << std::endl; }
+            glfwTerminate();
+            return -1;
+        }
+
+        if (optimize_triangles) {
+            std::vector<uint32_t> indices;
+            for (size_t s = 0; s < shapes.size(); s++) {
+                for (size_t i = 0; i < shapes[s].mesh.indices.size(); i++) {
+                    indices.push_back(shapes[s].mesh.indices[i].vertex_index);
+                }
+            }
+            std::cout << "ACMR before triangle reordering: "
+                      << averageCacheMissRatio(indices.data(), indices.size() / 3, attrib.vertices.size() / 3, 16)
+                      << std::endl;
+            optimize_triangle_order(attrib, shapes);
+        }
+        g_mesh = Mesh::fromObj(attrib, shapes);
+    }  // everything else reads the mesh
+
+    // results are printed per vertex of the file; weld_remap maps them to the vertices of the welded mesh
+    std::vector<uint32_t> weld_remap;
+    if (weld_epsilon >= 0.f) {
+        if (weld_epsilon == 0.f) weld_epsilon = 1e-6f * glm::length(g_mesh->boundsMax() - g_mesh->boundsMin());
+        double start = glfwGetTime();
+        WeldStats stats;
+        g_mesh = weldVertices(*g_mesh, weld_epsilon, weld_remap, &stats);
+        printf("weld: removed %zu duplicate vertices and %zu faces (epsilon %g) in %.3f s\n", stats.duplicates,
+               stats.droppedFaces, weld_epsilon, glfwGetTime() - start);
+    } else {
+        weld_remap.resize(g_mesh->numVertices());
+        for (size_t i = 0; i < weld_remap.size(); ++i) weld_remap[i] = i;
+    }
+    if (g_mesh->numFaces() == 0 && g_mesh->numVertices() > 0) {
+        double start = glfwGetTime();
+        g_mesh = pointCloudMesh(*g_mesh, knn, tangent_sine);
+        printf("point cloud: %zu-nearest-neighbor graph with %zu edges in %.3f s\n", knn,
+               g_mesh->graph().neighbors.size() / 2, glfwGetTime() - start);
     }
+    const std::vector<uint32_t>& indices = g_mesh->indices();
+    if (optimize_triangles) {
+        std::cout << "ACMR after triangle reordering: "
+                  << averageCacheMissRatio(indices.data(), g_mesh->numFaces(), g_mesh->numVertices(), 16) << std::endl;
+    }
+    g_bvh.build(reinterpret_cast<const float*>(g_mesh->positions().data()), indices.data(), g_mesh->numFaces());
 
-    g_draw_objects.resize(g_shapes.size());
+    if (g_mesh->numFaces() == 0 && (alg == FAST_SWEEPING || alg == STEINER || alg == LOD)) {
+        std::cout << "the selected algorithm needs faces, using dijkstra's on the point cloud instead" << std::endl;
+        alg = DIJKSTRA;
+    }
 
     size_t src_vertex_id = 0;
-    std::unique_ptr<DistanceAlgorithm> g;
+    std::unique_ptr<DistanceAlgorithm>& g = g_algorithm;
+    LodAlgorithm* lod_algorithm = nullptr;  // its pyramid is reused for drawing
     switch (alg) {
         case WORLD_SPACE: {
             std::cout << "using world space distance" << std::endl;
@@ -432,33 +748,58 @@ int main(int argc, char** argv) {
             std::cout << "using dijstra's with edge distance" << std::endl;
             g.reset(new DijkstraAlgorithm());
         } break;
+        case DELTA_STEPPING: {
+            std::cout << "using parallel delta-stepping with edge distance" << std::endl;
+            g.reset(new DeltaSteppingAlgorithm());
+        } break;
+        case FAST_SWEEPING: {
+            std::cout << "using fast sweeping eikonal solver" << std::endl;
+            g.reset(new FastSweepingAlgorithm());
+        } break;
+        case STEINER: {
+            std::cout << "using dijkstra's with " << steiner_points << " steiner points per edge" << std::endl;
+            g.reset(new SteinerAlgorithm(steiner_points));
+        } break;
+        case LOD: {
+            float radius = std::numeric_limits<float>::max();
+            if (lod_radius >= 0.f) radius = lod_radius * glm::length(g_mesh->boundsMax() - g_mesh->boundsMin());
+            std::cout << "using coarse-to-fine dijkstra's down to level " << lod_finest;
+            if (lod_radius >= 0.f) std::cout << ", a preview exact only well within " << radius << " of the source";
+            std::cout << std::endl;
+            lod_algorithm = new LodAlgorithm(radius, lod_finest);
+            g.reset(lod_algorithm);
+        } break;
     }
-    g->load(g_attrib, g_shapes);
-    g_distance = g->propagate(src_vertex_id);
-    for (size_t i = 0; i < g_distance.size(); ++i) { std::cout << i << ": " << g_distance[i] << std::endl; }
-
-    DrawPoints source;
-    {
-        std::vector<float> buffer;
-        buffer.push_back(g_attrib.vertices[3 * src_vertex_id + 0]);
-        buffer.push_back(g_attrib.vertices[3 * src_vertex_id + 1]);
-        buffer.push_back(g_attrib.vertices[3 * src_vertex_id + 2]);
-        glGenBuffers(1, &source.vb_id);
-        glBindBuffer(GL_ARRAY_BUFFER, source.vb_id);
-        glBufferData(GL_ARRAY_BUFFER, buffer.size() * sizeof(float), &buffer.at(0), GL_STATIC_DRAW);
-        source.numPoints = buffer.size() / 3;
+    if (vertex_order != VERTEX_ORDER_NONE) g.reset(new ReorderedAlgorithm(g.release(), vertex_order));
+    g->load(g_mesh);
+    if (lod_algorithm && lod_algorithm->getFinestLevel() != lod_finest) {
+        std::cout << "only " << lod_algorithm->getLod().size() << " levels of detail, solving down to level "
+                  << lod_algorithm->getFinestLevel() << std::endl;
     }
-
-    if (!update_draw_objects(g_bmin, g_bmax, g_draw_objects, g_attrib, g_shapes)) {
-        glfwTerminate();
-        return -1;
+    g_distance = g->propagate(weld_remap[src_vertex_id]);
+    for (size_t i = 0; i < weld_remap.size(); ++i) {
+        std::cout << i << ": " << g_distance[weld_remap[i]] << std::endl;
     }
 
-    update_draw_points(g_attrib);
+    g_source_position = g_mesh->positions()[weld_remap[src_vertex_id]];
+    update_draw_source(g_source_position);
+    update_draw_objects(g_draw_mesh, *g_mesh);
+    update_draw_points(*g_mesh);
+    update_draw_isolines();
+
+    if (lod && lod_algorithm && vertex_order == VERTEX_ORDER_NONE) {
+        g_lod = lod_algorithm->getLod();
+    } else if (lod && g_mesh->numFaces() > 0) {
+        double start = glfwGetTime();
+        g_lod.build(g_mesh->positions().data(), g_mesh->numVertices(), indices.data(), g_mesh->numFaces());
+        std::cout << "built " << g_lod.size() << " levels of detail in " << glfwGetTime() - start << " s" << std::endl;
+    }
 
-    float maxExtent = 0.5f * (g_bmax[0] - g_bmin[0]);
-    if (maxExtent < 0.5f * (g_bmax[1] - g_bmin[1])) { maxExtent = 0.5f * (g_bmax[1] - g_bmin[1]); }
-    if (maxExtent < 0.5f * (g_bmax[2] - g_bmin[2])) { maxExtent = 0.5f * (g_bmax[2] - g_bmin[2]); }
+    const glm::vec3& bmin = g_mesh->boundsMin();
+    const glm::vec3& bmax = g_mesh->boundsMax();
+    float maxExtent = 0.5f * (bmax[0] - bmin[0]);
+    if (maxExtent < 0.5f * (bmax[1] - bmin[1])) { maxExtent = 0.5f * (bmax[1] - bmin[1]); }
+    if (maxExtent < 0.5f * (bmax[2] - bmin[2])) { maxExtent = 0.5f * (bmax[2] - bmin[2]); }
 
     while (glfwWindowShouldClose(window) == GL_FALSE) {
         glfwPollEvents();
@@ -479,14 +820,30 @@ int main(int argc, char** argv) {
         glScalef(1.0f / maxExtent, 1.0f / maxExtent, 1.0f / maxExtent);
 
         // center object
-        glTranslatef(-0.5 * (g_bmax[0] + g_bmin[0]), -0.5 * (g_bmax[1] + g_bmin[1]), -0.5 * (g_bmax[2] + g_bmin[2]));
-
-        draw(g_draw_objects);
+        glTranslatef(-0.5 * (bmax[0] + bmin[0]), -0.5 * (bmax[1] + bmin[1]), -0.5 * (bmax[2] + bmin[2]));
+
+        // coarsest level of detail whose error stays below a pixel; the model is scaled by 1 / maxExtent and seen
+        // from about the distance of the eye to the origin
+        size_t lod_level = 0;
+        if (g_lod.size() > 1) {
+            float distance = std::max(glm::length(glm::vec3(eye[0], eye[1], eye[2])), 1e-3f);
+            float pixels_per_unit = height / (2.f * std::tan(0.5f * 45.f * float(M_PI) / 180.f) * distance * maxExtent);
+            lod_level = g_lod.selectLevel(pixels_per_unit);
+        }
+        if (lod_level != g_lod_level) {
+            g_lod_level = lod_level;
+            update_draw_lod();
+        }
+        draw(g_lod_level > 0 ? g_draw_lod : g_draw_mesh);
 
         float src_color[3] = {0.f, 1.f, 0.f};
         float in_radius_color[3] = {0.8f, 0.6f, 0.6f};
-        draw(source, src_color);
+        draw(g_draw_source, src_color);
         if (g_draw_points.numPoints) { draw(g_draw_points, in_radius_color); }
+        float path_color[3] = {1.f, 1.f, 0.f};
+        if (g_draw_path.numPoints) { draw_lines(g_draw_path, GL_LINE_STRIP, path_color); }
+        float isoline_color[3] = {1.f, 1.f, 1.f};
+        if (g_draw_isolines.numPoints) { draw_lines(g_draw_isolines, GL_LINES, isoline_color); }
 
         glfwSwapBuffers(window);
     }
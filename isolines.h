@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "parallel.h"
+
+// Marching triangles over a per-vertex field. For every isovalue and every face whose corner values straddle it,
+// emits one segment as two xyz points into lines (ready for a GL_LINES buffer). Faces are processed in parallel
+// blocks; a count pass and a prefix sum over the blocks give each block its output range, so the result is
+// deterministic and lines is only reallocated when it grows. Faces touching unreached vertices (float max) are
+// skipped.
+inline void extractIsolines(const float* positions, const uint32_t* indices, size_t numFaces, const float* field,
+                            std::vector<float> isovalues, std::vector<float>& lines) {
+    static const size_t kBlockSize = 4096;
+    const size_t numBlocks = (numFaces + kBlockSize - 1) / kBlockSize;
+    std::sort(isovalues.begin(), isovalues.end());
+
+    // visits the isovalues crossing face f; returns the number of segments, writing them to out if given
+    auto march = [&](size_t f, float* out) -> size_t {
+        const uint32_t* c = indices + 3 * f;
+        float d[3] = {field[c[0]], field[c[1]], field[c[2]]};
+        float lo = std::min(d[0], std::min(d[1], d[2]));
+        float hi = std::max(d[0], std::max(d[1], d[2]));
+        if (hi == std::numeric_limits<float>::max()) return 0;
+
+        size_t segments = 0;
+        for (auto iso = std::upper_bound(isovalues.begin(), isovalues.end(), lo);
+             iso != isovalues.end() && *iso <= hi; ++iso) {
+            if (out) {
+                // a corner is above if d >= iso; the two crossed edges are those with differing sides
+                for (int e = 0; e < 3; ++e) {
+                    int i = e, j = (e + 1) % 3;
+                    if ((d[i] >= *iso) == (d[j] >= *iso)) continue;
+                    float t = (*iso - d[i]) / (d[j] - d[i]);
+                    const float* pi = positions + 3 * c[i];
+                    const float* pj = positions + 3 * c[j];
+                    for (int k = 0; k < 3; ++k) *out++ = pi[k] + t * (pj[k] - pi[k]);
+                }
+            }
+            ++segments;
+        }
+        return segments;
+    };
+
+    std::vector<size_t> offsets(numBlocks + 1, 0);
+    parallelFor(numBlocks, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            size_t count = 0;
+            size_t last = std::min(numFaces, (b + 1) * kBlockSize);
+            for (size_t f = b * kBlockSize; f < last; ++f) count += march(f, nullptr);
+            offsets[b + 1] = count;
+        }
+    });
+    for (size_t b = 0; b < numBlocks; ++b) offsets[b + 1] += offsets[b];
+
+    lines.resize(6 * offsets[numBlocks]);
+    parallelFor(numBlocks, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            float* out = lines.data() + 6 * offsets[b];
+            size_t last = std::min(numFaces, (b + 1) * kBlockSize);
+            for (size_t f = b * kBlockSize; f < last; ++f) out += 6 * march(f, out);
+        }
+    });
+}
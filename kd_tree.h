@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include "parallel.h"
+
+// Implicit KD-tree over a point set for ball and k-nearest queries. The points are reordered so that every node
+// covers a contiguous range: the root covers all of them, and the node covering [begin, end) splits at the median
+// mid = begin + (end - begin) / 2 into [begin, mid) and [mid, end), along the axis in which the range is widest.
+// Nodes are numbered like a binary heap and store only their split axis and value; the ranges are recomputed while
+// descending. Leaves hold at most kLeafSize points, whose coordinates are kept in separate x, y and z arrays so that
+// a leaf scan reads three contiguous runs and tests four points at a time.
+class KdTree {
+   public:
+    static const size_t kLeafSize = 16;
+
+    KdTree() : depth(0), splitAxis(), splitValue(), xs(), ys(), zs(), ids() {}
+
+    void build(const glm::vec3* points, size_t n) {
+        depth = 0;
+        while (n > 0 && ((n - 1) >> depth) >= kLeafSize) ++depth;  // halves have up to ceil(size / 2) points
+        splitAxis.assign((size_t(1) << depth) - 1, 0);
+        splitValue.assign(splitAxis.size(), 0.f);
+        ids.resize(n);
+        for (size_t i = 0; i < n; ++i) ids[i] = i;
+
+        // the nodes of a level cover disjoint ranges and are split concurrently
+        for (size_t level = 0; level < depth; ++level) {
+            size_t first = (size_t(1) << level) - 1;
+            parallelFor(size_t(1) << level, 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) split(first + i, level, points);
+            });
+        }
+
+        xs.resize(n);
+        ys.resize(n);
+        zs.resize(n);
+        parallelFor(n, 4096, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                xs[i] = points[ids[i]][0];
+                ys[i] = points[ids[i]][1];
+                zs[i] = points[ids[i]][2];
+            }
+        });
+    }
+
+    size_t size() const { return ids.size(); }
+
+    // Points at most radius from center as (id, distance), in no particular order.
+    void within(const glm::vec3& center, float radius, std::vector<std::pair<uint32_t, float>>& out) const {
+        out.clear();
+        if (ids.empty() || !(radius >= 0.f)) return;
+        within(0, 0, 0, ids.size(), center, radius, out);
+    }
+
+    // The k points nearest to center as (id, distance), nearest first. Ties are broken by id.
+    void nearest(const glm::vec3& center, size_t k, std::vector<std::pair<uint32_t, float>>& out) const {
+        out.clear();
+        if (ids.empty() || k == 0) return;
+        nearest(0, 0, 0, ids.size(), center, k, out);  // out is a max-heap until sorted
+        std::sort_heap(out.begin(), out.end(), closer);
+        for (size_t i = 0; i < out.size(); ++i) out[i].second = std::sqrt(out[i].second);
+    }
+
+    // Point ids in tree order, in which nearby points are close together.
+    const std::vector<uint32_t>& getOrder() const { return ids; }
+
+   private:
+    static bool closer(const std::pair<uint32_t, float>& a, const std::pair<uint32_t, float>& b) {
+        return a.second < b.second || (a.second == b.second && a.first < b.first);
+    }
+
+    // Range of node i of the given level, by descending from the root.
+    void range(size_t level, size_t i, size_t& begin, size_t& end) const {
+        begin = 0;
+        end = ids.size();
+        for (size_t l = level; l-- > 0;) {
+            size_t mid = begin + (end - begin) / 2;
+            if ((i >> l) & 1) {
+                begin = mid;
+            } else {
+                end = mid;
+            }
+        }
+    }
+
+    void split(size_t node, size_t level, const glm::vec3* points) {
+        size_t begin, end;
+        range(level, node + 1 - (size_t(1) << level), begin, end);
+        glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+        for (size_t i = begin; i < end; ++i) {
+            lo = glm::min(lo, points[ids[i]]);
+            hi = glm::max(hi, points[ids[i]]);
+        }
+        glm::vec3 extent = hi - lo;
+        int axis = extent[0] >= extent[1] && extent[0] >= extent[2] ? 0 : extent[1] >= extent[2] ? 1 : 2;
+
+        size_t mid = begin + (end - begin) / 2;
+        std::nth_element(ids.begin() + begin, ids.begin() + mid, ids.begin() + end,
+                         [&](uint32_t a, uint32_t b) { return points[a][axis] < points[b][axis]; });
+        splitAxis[node] = axis;
+        splitValue[node] = points[ids[mid]][axis];
+    }
+
+    // Calls visit(i, squared distance) for the points of [begin, end) with a squared distance to center of at most
+    // bound(), which visit may lower.
+    template <typename Bound, typename Visit>
+    void scan(size_t begin, size_t end, const glm::vec3& center, Bound bound, Visit visit) const {
+        size_t i = begin;
+#if defined(__SSE2__)
+        const __m128 cx = _mm_set1_ps(center[0]), cy = _mm_set1_ps(center[1]), cz = _mm_set1_ps(center[2]);
+        for (; i + 4 <= end; i += 4) {
+            __m128 dx = _mm_sub_ps(_mm_loadu_ps(&xs[i]), cx);
+            __m128 dy = _mm_sub_ps(_mm_loadu_ps(&ys[i]), cy);
+            __m128 dz = _mm_sub_ps(_mm_loadu_ps(&zs[i]), cz);
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            int mask = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_set1_ps(bound())));
+            if (mask == 0) continue;
+            float lanes[4];
+            _mm_storeu_ps(lanes, d2);
+            for (int k = 0; k < 4; ++k) {
+                if (((mask >> k) & 1) && lanes[k] <= bound()) visit(i + k, lanes[k]);
+            }
+        }
+#endif
+        for (; i < end; ++i) {
+            float dx = xs[i] - center[0], dy = ys[i] - center[1], dz = zs[i] - center[2];
+            float d2 = dx * dx + dy * dy + dz * dz;
+            if (d2 <= bound()) visit(i, d2);
+        }
+    }
+
+    void within(size_t node, size_t level, size_t begin, size_t end, const glm::vec3& center, float radius,
+                std::vector<std::pair<uint32_t, float>>& out) const {
+        if (level == depth) {
+            float r2 = radius * radius;
+            scan(begin, end, center, [r2] { return r2; },
+                 [&](size_t i, float d2) { out.push_back(std::make_pair(ids[i], std::sqrt(d2))); });
+            return;
+        }
+        size_t mid = begin + (end - begin) / 2;
+        float d = center[splitAxis[node]] - splitValue[node];
+        if (d <= radius) within(2 * node + 1, level + 1, begin, mid, center, radius, out);
+        if (d >= -radius) within(2 * node + 2, level + 1, mid, end, center, radius, out);
+    }
+
+    void nearest(size_t node, size_t level, size_t begin, size_t end, const glm::vec3& center, size_t k,
+                 std::vector<std::pair<uint32_t, float>>& heap) const {
+        auto worst = [&] { return heap.size() < k ? std::numeric_limits<float>::max() : heap.front().second; };
+        if (level == depth) {
+            scan(begin, end, center, worst, [&](size_t i, float d2) {
+                std::pair<uint32_t, float> candidate(ids[i], d2);
+                if (heap.size() == k) {
+                    if (!closer(candidate, heap.front())) return;
+                    std::pop_heap(heap.begin(), heap.end(), closer);
+                    heap.pop_back();
+                }
+                heap.push_back(candidate);
+                std::push_heap(heap.begin(), heap.end(), closer);
+            });
+            return;
+        }
+        // the side of the split plane holding center first; the other only if the plane is closer than the worst
+        size_t mid = begin + (end - begin) / 2;
+        float d = center[splitAxis[node]] - splitValue[node];
+        if (d <= 0.f) {
+            nearest(2 * node + 1, level + 1, begin, mid, center, k, heap);
+            if (d * d <= worst()) nearest(2 * node + 2, level + 1, mid, end, center, k, heap);
+        } else {
+            nearest(2 * node + 2, level + 1, mid, end, center, k, heap);
+            if (d * d <= worst()) nearest(2 * node + 1, level + 1, begin, mid, center, k, heap);
+        }
+    }
+
+    size_t depth;                    // leaves are the nodes of this level
+    std::vector<uint8_t> splitAxis;  // per inner node, numbered like a binary heap
+    std::vector<float> splitValue;   // points left of the split are <= it, points right of it >= it
+    std::vector<float> xs, ys, zs;   // point coordinates in tree order
+    std::vector<uint32_t> ids;       // point ids in tree order
+};
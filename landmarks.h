@@ -0,0 +1,211 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "distance_dijkstra.h"
+#include "parallel.h"
+
+// Distances from K landmark vertices to every vertex, quantized to 16 bits with a per-landmark scale. By the
+// triangle inequality they bound the distance between any two vertices from below and above, which answers
+// approximate queries in O(K) and makes a much tighter A* heuristic than the straight-line distance.
+//
+// The table is vertex-major (the K entries of a vertex are adjacent) and can be saved next to the mesh and mapped
+// back into memory without parsing.
+class LandmarkTable {
+   public:
+    static const uint16_t kUnreachable = 0xffff;
+
+    LandmarkTable()
+        : numVertices(0), numLandmarks(0), landmarks(nullptr), scales(nullptr), table(nullptr), mapped(nullptr),
+          mappedSize(0), storage() {}
+    ~LandmarkTable() { unmap(); }
+
+    // Picks numLandmarks vertices by farthest-point selection on straight-line distance, then runs one propagation
+    // per landmark in parallel.
+    void build(const DijkstraAlgorithm& dijkstra, size_t count) {
+        unmap();
+        const std::vector<glm::vec3>& p = dijkstra.getVertices();
+        numVertices = p.size();
+        numLandmarks = std::min(count, numVertices);
+        allocate();
+
+        // start from the vertex farthest from an arbitrary one, which lies on the hull
+        uint32_t next = 0;
+        for (size_t v = 1; v < numVertices; ++v) {
+            if (glm::length(p[v] - p[0]) > glm::length(p[next] - p[0])) next = v;
+        }
+        std::vector<float> nearest(numVertices, std::numeric_limits<float>::max());
+        for (size_t k = 0; k < numLandmarks; ++k) {
+            storage.landmarks[k] = next;
+            float farthest = -1.f;
+            for (size_t v = 0; v < numVertices; ++v) {
+                nearest[v] = std::min(nearest[v], glm::length(p[v] - p[storage.landmarks[k]]));
+                if (nearest[v] > farthest) {
+                    farthest = nearest[v];
+                    next = v;
+                }
+            }
+        }
+
+        parallelFor(numLandmarks, 1, [&](size_t begin, size_t end) {
+            std::vector<float> dist;
+            std::vector<uint32_t> pred;
+            for (size_t k = begin; k < end; ++k) {
+                dijkstra.distancesFrom(storage.landmarks[k], dist, pred);
+                float maxDist = 0.f;
+                for (size_t v = 0; v < numVertices; ++v) {
+                    if (dist[v] != std::numeric_limits<float>::max()) maxDist = std::max(maxDist, dist[v]);
+                }
+                float scale = maxDist > 0.f ? maxDist / (kUnreachable - 1) : 1.f;
+                storage.scales[k] = scale;
+                for (size_t v = 0; v < numVertices; ++v) {
+                    uint16_t q = kUnreachable;
+                    if (dist[v] != std::numeric_limits<float>::max()) {
+                        q = std::min<float>(std::floor(dist[v] / scale), kUnreachable - 1);
+                    }
+                    storage.table[v * numLandmarks + k] = q;
+                }
+            }
+        });
+    }
+
+    // Quantization rounds down, so every stored value q stands for a distance in [q * scale, (q + 1) * scale).
+    float lowerBound(uint32_t s, uint32_t t) const {
+        const uint16_t* qs = table + s * numLandmarks;
+        const uint16_t* qt = table + t * numLandmarks;
+        float bound = 0.f;
+        for (size_t k = 0; k < numLandmarks; ++k) {
+            if (qs[k] == kUnreachable || qt[k] == kUnreachable) continue;
+            int diff = std::abs(int(qs[k]) - int(qt[k])) - 1;
+            bound = std::max(bound, diff * scales[k]);
+        }
+        return bound;
+    }
+
+    float upperBound(uint32_t s, uint32_t t) const {
+        const uint16_t* qs = table + s * numLandmarks;
+        const uint16_t* qt = table + t * numLandmarks;
+        float bound = std::numeric_limits<float>::max();
+        for (size_t k = 0; k < numLandmarks; ++k) {
+            if (qs[k] == kUnreachable || qt[k] == kUnreachable) continue;
+            bound = std::min(bound, (qs[k] + qt[k] + 2) * scales[k]);
+        }
+        return bound;
+    }
+
+    float approximate(uint32_t s, uint32_t t) const {
+        float upper = upperBound(s, t);
+        return upper == std::numeric_limits<float>::max() ? upper : 0.5f * (lowerBound(s, t) + upper);
+    }
+
+    // Admissible A* heuristic towards dst, for DijkstraAlgorithm::distance.
+    struct Heuristic {
+        const LandmarkTable* table;
+        uint32_t dst;
+        float operator()(uint32_t v) const { return table->lowerBound(v, dst); }
+    };
+    Heuristic heuristic(uint32_t dst) const {
+        Heuristic h = {this, dst};
+        return h;
+    }
+
+    size_t size() const { return numLandmarks; }
+    uint32_t landmark(size_t k) const { return landmarks[k]; }
+
+    bool save(const std::string& path) const {
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f) return false;
+        Header header;
+        memcpy(header.magic, kMagic, sizeof(header.magic));
+        header.numVertices = numVertices;
+        header.numLandmarks = numLandmarks;
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+        ok = ok && fwrite(landmarks, sizeof(uint32_t), numLandmarks, f) == numLandmarks;
+        ok = ok && fwrite(scales, sizeof(float), numLandmarks, f) == numLandmarks;
+        ok = ok && fwrite(table, sizeof(uint16_t), numVertices * numLandmarks, f) == numVertices * numLandmarks;
+        return fclose(f) == 0 && ok;
+    }
+
+    // Maps a saved table read-only; returns false if the file is missing or was built for another vertex count.
+    bool map(const std::string& path, size_t expectedVertices) {
+        unmap();
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        void* data = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(Header)) {
+            data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (data == MAP_FAILED) return false;
+
+        const Header* header = static_cast<const Header*>(data);
+        size_t k = header->numLandmarks, n = header->numVertices;
+        if (memcmp(header->magic, kMagic, sizeof(header->magic)) != 0 || n != expectedVertices ||
+            size_t(st.st_size) < sizeof(Header) + k * (sizeof(uint32_t) + sizeof(float)) + n * k * sizeof(uint16_t)) {
+            munmap(data, st.st_size);
+            return false;
+        }
+
+        mapped = data;
+        mappedSize = st.st_size;
+        numVertices = n;
+        numLandmarks = k;
+        const char* bytes = static_cast<const char*>(data) + sizeof(Header);
+        landmarks = reinterpret_cast<const uint32_t*>(bytes);
+        scales = reinterpret_cast<const float*>(bytes + k * sizeof(uint32_t));
+        table = reinterpret_cast<const uint16_t*>(bytes + k * (sizeof(uint32_t) + sizeof(float)));
+        return true;
+    }
+
+   private:
+    LandmarkTable(const LandmarkTable&);
+    LandmarkTable& operator=(const LandmarkTable&);
+
+    struct Header {
+        char magic[8];
+        uint32_t numVertices;
+        uint32_t numLandmarks;
+    };
+    static constexpr const char* kMagic = "GEOLMK01";
+
+    void allocate() {
+        storage.landmarks.assign(numLandmarks, 0);
+        storage.scales.assign(numLandmarks, 1.f);
+        storage.table.assign(numVertices * numLandmarks, uint16_t(kUnreachable));
+        landmarks = storage.landmarks.data();
+        scales = storage.scales.data();
+        table = storage.table.data();
+    }
+
+    void unmap() {
+        if (mapped) munmap(mapped, mappedSize);
+        mapped = nullptr;
+        mappedSize = 0;
+    }
+
+    size_t numVertices, numLandmarks;
+    const uint32_t* landmarks;
+    const float* scales;
+    const uint16_t* table;
+
+    void* mapped;
+    size_t mappedSize;
+    struct {
+        std::vector<uint32_t> landmarks;
+        std::vector<float> scales;
+        std::vector<uint16_t> table;
+    } storage;
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "tinyobjloader/tiny_obj_loader.h"
+
+#include <glm/glm.hpp>
+
+#include "edge_graph.h"
+
+// Read-only triangle mesh shared by the distance algorithms and the viewer, so one loaded mesh is stored once however
+// many of them use it. Positions and indices are set at construction; the adjacency, edge list, face normals and
+// bounding box are built on first use, safely from any number of threads, and kept for the lifetime of the mesh.
+class Mesh {
+   public:
+    Mesh()
+        : vertexPositions(),
+          faceIndices(std::make_shared<const std::vector<uint32_t>>()),
+          adjacency(),
+          edgeList(),
+          normals(),
+          boundsOnce(),
+          lo(0.f),
+          hi(0.f) {}
+
+    Mesh(std::vector<glm::vec3> positions, std::vector<uint32_t> indices)
+        : vertexPositions(std::move(positions)),
+          faceIndices(std::make_shared<const std::vector<uint32_t>>(std::move(indices))),
+          adjacency(),
+          edgeList(),
+          normals(),
+          boundsOnce(),
+          lo(0.f),
+          hi(0.f) {}
+
+    // A mesh whose edge graph is given instead of derived from the faces, such as the neighbor graph of a point cloud.
+    Mesh(std::vector<glm::vec3> positions, std::vector<uint32_t> indices, EdgeGraph graph)
+        : Mesh(std::move(positions), std::move(indices)) {
+        std::call_once(adjacency.once, [&] {
+            adjacency.value = std::move(graph);
+            adjacency.built = true;
+        });
+    }
+
+    // Faces of all shapes in order; polygons must have been triangulated by the loader.
+    static std::shared_ptr<const Mesh> fromObj(const tinyobj::attrib_t& attrib,
+                                               const std::vector<tinyobj::shape_t>& shapes) {
+        std::vector<glm::vec3> positions(attrib.vertices.size() / 3);
+        for (size_t i = 0; i < positions.size(); ++i) {
+            const float* p = &attrib.vertices[3 * i];
+            positions[i] = glm::vec3(p[0], p[1], p[2]);
+        }
+        std::vector<uint32_t> indices;
+        for (size_t s = 0; s < shapes.size(); ++s) {
+            const std::vector<tinyobj::index_t>& shapeIndices = shapes[s].mesh.indices;
+            for (size_t i = 0; i < shapeIndices.size(); ++i) indices.push_back(shapeIndices[i].vertex_index);
+        }
+        return std::make_shared<const Mesh>(std::move(positions), std::move(indices));
+    }
+
+    // The same faces at new positions (x, y, z per vertex). The index buffer is shared, and an adjacency that was
+    // already built keeps its topology with new edge lengths.
+    std::shared_ptr<const Mesh> withPositions(const float* xyz) const { return withPositions(xyz, false); }
+
+    // Same, but when the caller passes in its only reference to mesh, the adjacency and edge list are moved over
+    // instead of copied and the edge lengths are rewritten in place, so a mesh deformed every frame reallocates only
+    // its positions.
+    static std::shared_ptr<const Mesh> withPositions(std::shared_ptr<const Mesh> mesh, const float* xyz) {
+        bool sole = mesh.use_count() == 1;
+        return mesh->withPositions(xyz, sole);
+    }
+
+    size_t numVertices() const { return vertexPositions.size(); }
+    size_t numFaces() const { return faceIndices->size() / 3; }
+
+    const std::vector<glm::vec3>& positions() const { return vertexPositions; }
+    const std::vector<uint32_t>& indices() const { return *faceIndices; }  // three vertices per face
+
+    // Edge graph weighted by edge length.
+    const EdgeGraph& graph() const {
+        std::call_once(adjacency.once, [this] {
+            adjacency.value.build(numVertices(), faceIndices->data(), numFaces(), vertexPositions.data());
+            adjacency.built = true;
+        });
+        return adjacency.value;
+    }
+
+    // Each undirected edge once as (u, v) with u < v, sorted.
+    const std::vector<std::pair<uint32_t, uint32_t>>& edges() const {
+        std::call_once(edgeList.once, [this] {
+            const EdgeGraph& g = graph();
+            for (size_t u = 0; u < g.size(); ++u) {
+                for (uint32_t e = g.offsets[u]; e < g.offsets[u + 1]; ++e) {
+                    if (g.neighbors[e] > u) edgeList.value.push_back(std::make_pair(uint32_t(u), g.neighbors[e]));
+                }
+            }
+            edgeList.built = true;
+        });
+        return edgeList.value;
+    }
+
+    // Unit normal of each face by the right-hand rule, zero for degenerate faces.
+    const std::vector<glm::vec3>& faceNormals() const {
+        std::call_once(normals.once, [this] {
+            const std::vector<uint32_t>& f = *faceIndices;
+            normals.value.resize(numFaces());
+            for (size_t i = 0; i < normals.value.size(); ++i) {
+                const glm::vec3& a = vertexPositions[f[3 * i]];
+                glm::vec3 n = glm::cross(vertexPositions[f[3 * i + 1]] - a, vertexPositions[f[3 * i + 2]] - a);
+                float length = glm::length(n);
+                normals.value[i] = length > 0.f ? n / length : glm::vec3(0.f);
+            }
+        });
+        return normals.value;
+    }
+
+    // Bounding box of all vertices; both corners are zero for an empty mesh.
+    const glm::vec3& boundsMin() const {
+        computeBounds();
+        return lo;
+    }
+
+    const glm::vec3& boundsMax() const {
+        computeBounds();
+        return hi;
+    }
+
+   private:
+    Mesh(const Mesh&);
+    Mesh& operator=(const Mesh&);
+
+    template <typename T>
+    struct Lazy {
+        Lazy() : once(), built(false), value() {}
+        std::once_flag once;
+        std::atomic<bool> built;  // set once value is complete
+        T value;
+    };
+
+    void computeBounds() const {
+        std::call_once(boundsOnce, [this] {
+            if (vertexPositions.empty()) return;
+            lo = glm::vec3(std::numeric_limits<float>::max());
+            hi = glm::vec3(-std::numeric_limits<float>::max());
+            for (size_t i = 0; i < vertexPositions.size(); ++i) {
+                lo = glm::min(lo, vertexPositions[i]);
+                hi = glm::max(hi, vertexPositions[i]);
+            }
+        });
+    }
+
+    // Takes the adjacency and edge list of this mesh if steal is set; it must not be used afterwards.
+    std::shared_ptr<const Mesh> withPositions(const float* xyz, bool steal) const {
+        std::shared_ptr<Mesh> moved = std::make_shared<Mesh>();
+        moved->vertexPositions.resize(vertexPositions.size());
+        for (size_t i = 0; i < vertexPositions.size(); ++i) {
+            moved->vertexPositions[i] = glm::vec3(xyz[3 * i + 0], xyz[3 * i + 1], xyz[3 * i + 2]);
+        }
+        moved->faceIndices = faceIndices;
+        if (adjacency.built) {
+            std::call_once(moved->adjacency.once, [&] {
+                EdgeGraph& g = moved->adjacency.value;
+                if (steal) {
+                    g = std::move(adjacency.value);
+                } else {
+                    g.offsets = adjacency.value.offsets;
+                    g.neighbors = adjacency.value.neighbors;
+                    g.weights.resize(adjacency.value.weights.size());
+                }
+                g.updateWeights(moved->vertexPositions.data());
+                moved->adjacency.built = true;
+            });
+        }
+        if (steal && edgeList.built) {
+            std::call_once(moved->edgeList.once, [&] {
+                moved->edgeList.value = std::move(edgeList.value);
+                moved->edgeList.built = true;
+            });
+        }
+        return moved;
+    }
+
+    std::vector<glm::vec3> vertexPositions;
+    std::shared_ptr<const std::vector<uint32_t>> faceIndices;  // shared with meshes made by withPositions()
+
+    mutable Lazy<EdgeGraph> adjacency;
+    mutable Lazy<std::vector<std::pair<uint32_t, uint32_t>>> edgeList;
+    mutable Lazy<std::vector<glm::vec3>> normals;
+    mutable std::once_flag boundsOnce;
+    mutable glm::vec3 lo, hi;
+};
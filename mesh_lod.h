@@ -0,0 +1,367 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "edge_graph.h"
+
+// One level of detail. Levels keep the original vertex ids: decimation only removes vertices, so a coarse mesh
+// indexes the same positions as the full one.
+struct LodLevel {
+    std::vector<uint32_t> indices;         // triangles over original vertex ids
+    std::vector<uint32_t> vertexIds;       // vertices still present
+    std::vector<uint32_t> representative;  // original vertex -> present vertex it was collapsed into (parent map)
+    float error;                           // largest distance from a vertex to its representative
+    EdgeGraph graph;                       // edge graph of indices, rows of removed vertices are empty
+};
+
+// Level of detail pyramid built by quadric error decimation (Garland & Heckbert) with half-edge collapses. Level 0 is
+// the input; every following level has about half the faces of the previous one.
+class MeshLod {
+   public:
+    MeshLod() : positions(nullptr), levels() {}
+
+    void build(const glm::vec3* positions, size_t numVertices, const uint32_t* indices, size_t numFaces,
+               size_t minFaces = 1024) {
+        this->positions = positions;
+        levels.clear();
+        Decimator decimator(positions, numVertices, indices, numFaces);
+        levels.push_back(LodLevel());
+        decimator.snapshot(levels.back());
+
+        for (size_t target = numFaces / 2; target >= minFaces; target /= 2) {
+            if (!decimator.collapseUntil(target)) break;
+            levels.push_back(LodLevel());
+            decimator.snapshot(levels.back());
+        }
+    }
+
+    size_t size() const { return levels.size(); }
+    const LodLevel& level(size_t l) const { return levels[l]; }
+
+    // Coarsest level whose error stays below maxPixels on screen, given the size of one mesh unit in pixels.
+    size_t selectLevel(float pixelsPerUnit, float maxPixels = 1.f) const {
+        size_t l = 0;
+        while (l + 1 < levels.size() && levels[l + 1].error * pixelsPerUnit <= maxPixels) ++l;
+        return l;
+    }
+
+    // Coarse-to-fine distances from seeds, pairs of a vertex and its initial distance. The coarsest level is solved
+    // completely. Every finer level l starts from the coarser field prolonged to its vertices, a removed vertex taking
+    // the distance of its representative plus the straight-line offset to it, and re-solves only the band inside the
+    // coarse isoline at radius * sqrt(2)^l: a level has half the vertices of the next coarser one, so each band costs
+    // about the same as the ball of the given radius on the full mesh. Vertices outside the band keep the prolonged
+    // distance. Within the band the values are those of Dijkstra on the finest level solved, except where shortest
+    // paths leave the band; stopping at finestLevel > 0 gives a quick preview. Levels past the coarsest are clamped to
+    // it, and a pyramid that was never built gives no distances.
+    std::vector<float> propagate(const std::vector<std::pair<uint32_t, float>>& seeds, float radius,
+                                 size_t finestLevel = 0) const {
+        if (levels.empty()) return std::vector<float>();
+        finestLevel = std::min(finestLevel, levels.size() - 1);
+        const float kInf = std::numeric_limits<float>::max();
+        size_t n = levels[0].representative.size();
+        std::vector<float> dist(n, kInf), scratch(n, kInf);
+        std::vector<uint32_t> touched;
+
+        size_t coarsest = levels.size() - 1;
+        solve(levels[coarsest], seeds, nullptr, kInf, scratch, touched);
+        for (size_t i = 0; i < touched.size(); ++i) {
+            dist[touched[i]] = scratch[touched[i]];
+            scratch[touched[i]] = kInf;
+        }
+
+        for (size_t l = coarsest; l-- > finestLevel;) {
+            prolong(l, dist);
+            float bound = radius * std::pow(1.41421356f, float(l));
+            solve(levels[l], seeds, &dist, bound, scratch, touched);
+            for (size_t i = 0; i < touched.size(); ++i) {
+                dist[touched[i]] = scratch[touched[i]];
+                scratch[touched[i]] = kInf;
+            }
+        }
+
+        for (size_t l = finestLevel; l-- > 0;) prolong(l, dist);
+        return dist;
+    }
+
+    std::vector<float> propagate(uint32_t src, float radius, size_t finestLevel = 0) const {
+        return propagate(std::vector<std::pair<uint32_t, float>>(1, std::make_pair(src, 0.f)), radius, finestLevel);
+    }
+
+   private:
+    // Gives the vertices of level l that the next coarser level removed the distance of their representative there
+    // plus the straight-line offset to it.
+    void prolong(size_t l, std::vector<float>& dist) const {
+        const LodLevel& fine = levels[l];
+        const LodLevel& coarse = levels[l + 1];
+        for (size_t i = 0; i < fine.vertexIds.size(); ++i) {
+            uint32_t v = fine.vertexIds[i];
+            uint32_t r = coarse.representative[v];
+            if (r != v && dist[r] != std::numeric_limits<float>::max()) {
+                dist[v] = dist[r] + glm::length(positions[v] - positions[r]);
+            }
+        }
+    }
+
+    // Dijkstra on the level's graph from the representatives of the seeds. With a guide field, only vertices whose
+    // guide distance is at most bound are entered. Every vertex written to dist is appended to touched.
+    void solve(const LodLevel& level, const std::vector<std::pair<uint32_t, float>>& seeds,
+               const std::vector<float>* guide, float bound, std::vector<float>& dist,
+               std::vector<uint32_t>& touched) const {
+        typedef std::pair<float, uint32_t> entry_t;
+        std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>> queue;
+        touched.clear();
+        auto relax = [&](uint32_t v, float d) {
+            if (d >= dist[v]) return;
+            if (guide && (*guide)[v] > bound) return;
+            if (dist[v] == std::numeric_limits<float>::max()) touched.push_back(v);
+            dist[v] = d;
+            queue.push(std::make_pair(d, v));
+        };
+
+        for (size_t i = 0; i < seeds.size(); ++i) {
+            uint32_t root = level.representative[seeds[i].first];
+            relax(root, seeds[i].second + glm::length(positions[seeds[i].first] - positions[root]));
+        }
+        const EdgeGraph& g = level.graph;
+        while (!queue.empty()) {
+            float d = queue.top().first;
+            uint32_t u = queue.top().second;
+            queue.pop();
+            if (dist[u] != d) continue;
+            for (uint32_t e = g.offsets[u]; e < g.offsets[u + 1]; ++e) relax(g.neighbors[e], d + g.weights[e]);
+        }
+    }
+
+    // Symmetric 4x4 quadric, stored as its upper triangle.
+    struct Quadric {
+        double q[10];
+        Quadric() { std::fill(q, q + 10, 0.0); }
+        void addPlane(const glm::vec3& n, float d, double weight) {
+            double p[4] = {n[0], n[1], n[2], d};
+            int k = 0;
+            for (int i = 0; i < 4; ++i) {
+                for (int j = i; j < 4; ++j) q[k++] += weight * p[i] * p[j];
+            }
+        }
+        void add(const Quadric& o) {
+            for (int i = 0; i < 10; ++i) q[i] += o.q[i];
+        }
+        double evaluate(const glm::vec3& v) const {
+            double x = v[0], y = v[1], z = v[2];
+            return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x + q[4] * y * y + 2 * q[5] * y * z +
+                   2 * q[6] * y + q[7] * z * z + 2 * q[8] * z + q[9];
+        }
+    };
+
+    class Decimator {
+       public:
+        Decimator(const glm::vec3* positions, size_t numVertices, const uint32_t* indices, size_t numFaces)
+            : p(positions), faces(indices, indices + 3 * numFaces), faceAlive(numFaces, 1), liveFaces(numFaces),
+              vertexFaces(numVertices), parent(numVertices), version(numVertices, 0), quadrics(numVertices) {
+            for (size_t v = 0; v < numVertices; ++v) parent[v] = v;
+            for (size_t f = 0; f < numFaces; ++f) {
+                for (int k = 0; k < 3; ++k) vertexFaces[faces[3 * f + k]].push_back(f);
+                glm::vec3 n = glm::cross(p[faces[3 * f + 1]] - p[faces[3 * f]], p[faces[3 * f + 2]] - p[faces[3 * f]]);
+                float area = glm::length(n);
+                if (area == 0.f) continue;
+                n /= area;
+                for (int k = 0; k < 3; ++k) quadrics[faces[3 * f + k]].addPlane(n, -glm::dot(n, p[faces[3 * f]]), area);
+            }
+            addBoundaryConstraints();
+            for (size_t f = 0; f < numFaces; ++f) {
+                for (int k = 0; k < 3; ++k) {
+                    uint32_t u = faces[3 * f + k], v = faces[3 * f + (k + 1) % 3];
+                    push(u, v);
+                    push(v, u);
+                }
+            }
+        }
+
+        // Collapses the cheapest valid edges until at most target faces remain; false if none could be collapsed.
+        bool collapseUntil(size_t target) {
+            size_t before = liveFaces;
+            while (liveFaces > target && !heap.empty()) {
+                Candidate c = heap.top();
+                heap.pop();
+                if (version[c.u] != c.versionU || version[c.v] != c.versionV) continue;  // stale
+                if (parent[c.u] != c.u || parent[c.v] != c.v || !canCollapse(c.u, c.v)) continue;
+                collapse(c.u, c.v);
+            }
+            return liveFaces < before;
+        }
+
+        void snapshot(LodLevel& level) {
+            size_t n = parent.size();
+            level.indices.clear();
+            for (size_t f = 0; f < faceAlive.size(); ++f) {
+                if (faceAlive[f]) level.indices.insert(level.indices.end(), &faces[3 * f], &faces[3 * f] + 3);
+            }
+            level.vertexIds.clear();
+            level.representative.resize(n);
+            level.error = 0.f;
+            for (size_t v = 0; v < n; ++v) {
+                uint32_t r = find(v);
+                level.representative[v] = r;
+                if (r == v) level.vertexIds.push_back(v);
+                level.error = std::max(level.error, glm::length(p[v] - p[r]));
+            }
+            level.graph.build(n, level.indices.data(), level.indices.size() / 3, p);
+        }
+
+       private:
+        struct Candidate {
+            double cost;
+            uint32_t u, v;  // u collapses into v
+            uint32_t versionU, versionV;
+            bool operator>(const Candidate& o) const { return cost > o.cost; }
+        };
+
+        // Keeps open boundaries in place with steep planes through every boundary edge.
+        void addBoundaryConstraints() {
+            std::vector<std::pair<uint32_t, uint32_t>> edges;
+            for (size_t f = 0; f < faceAlive.size(); ++f) {
+                for (int k = 0; k < 3; ++k) {
+                    uint32_t a = faces[3 * f + k], b = faces[3 * f + (k + 1) % 3];
+                    edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+            for (size_t f = 0; f < faceAlive.size(); ++f) {
+                const uint32_t* t = &faces[3 * f];
+                glm::vec3 n = glm::cross(p[t[1]] - p[t[0]], p[t[2]] - p[t[0]]);
+                for (int k = 0; k < 3; ++k) {
+                    uint32_t a = t[k], b = t[(k + 1) % 3];
+                    std::pair<uint32_t, uint32_t> e(std::min(a, b), std::max(a, b));
+                    auto range = std::equal_range(edges.begin(), edges.end(), e);
+                    if (range.second - range.first != 1) continue;
+                    glm::vec3 m = glm::cross(p[b] - p[a], n);
+                    float l = glm::length(m);
+                    if (l == 0.f) continue;
+                    m /= l;
+                    double weight = 1e3 * glm::length(p[b] - p[a]) * glm::length(p[b] - p[a]);
+                    quadrics[a].addPlane(m, -glm::dot(m, p[a]), weight);
+                    quadrics[b].addPlane(m, -glm::dot(m, p[a]), weight);
+                }
+            }
+        }
+
+        uint32_t find(uint32_t v) {
+            while (parent[v] != v) {
+                parent[v] = parent[parent[v]];
+                v = parent[v];
+            }
+            return v;
+        }
+
+        void push(uint32_t u, uint32_t v) {
+            Quadric q = quadrics[u];
+            q.add(quadrics[v]);
+            Candidate c = {q.evaluate(p[v]), u, v, version[u], version[v]};
+            heap.push(c);
+        }
+
+        bool hasVertex(uint32_t f, uint32_t v) const {
+            return faces[3 * f] == v || faces[3 * f + 1] == v || faces[3 * f + 2] == v;
+        }
+
+        void neighbors(uint32_t u, std::vector<uint32_t>& out) const {
+            out.clear();
+            for (size_t i = 0; i < vertexFaces[u].size(); ++i) {
+                uint32_t f = vertexFaces[u][i];
+                for (int k = 0; k < 3; ++k) {
+                    if (faces[3 * f + k] != u) out.push_back(faces[3 * f + k]);
+                }
+            }
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        }
+
+        // Link condition (keeps the mesh manifold) and no flipped or degenerate faces around u.
+        bool canCollapse(uint32_t u, uint32_t v) {
+            size_t shared = 0;
+            for (size_t i = 0; i < vertexFaces[u].size(); ++i) shared += hasVertex(vertexFaces[u][i], v);
+            if (shared == 0) return false;
+
+            neighbors(u, linkU);
+            neighbors(v, linkV);
+            size_t common = 0;
+            for (size_t i = 0, j = 0; i < linkU.size() && j < linkV.size();) {
+                if (linkU[i] < linkV[j]) {
+                    ++i;
+                } else if (linkV[j] < linkU[i]) {
+                    ++j;
+                } else {
+                    ++common;
+                    ++i;
+                    ++j;
+                }
+            }
+            if (common != shared) return false;
+
+            for (size_t i = 0; i < vertexFaces[u].size(); ++i) {
+                uint32_t f = vertexFaces[u][i];
+                if (hasVertex(f, v)) continue;
+                glm::vec3 q[3], r[3];
+                for (int k = 0; k < 3; ++k) {
+                    q[k] = p[faces[3 * f + k]];
+                    r[k] = faces[3 * f + k] == u ? p[v] : q[k];
+                }
+                glm::vec3 before = glm::cross(q[1] - q[0], q[2] - q[0]);
+                glm::vec3 after = glm::cross(r[1] - r[0], r[2] - r[0]);
+                if (glm::dot(before, after) <= 0.2f * glm::length(before) * glm::length(after)) return false;
+            }
+            return true;
+        }
+
+        void collapse(uint32_t u, uint32_t v) {
+            for (size_t i = 0; i < vertexFaces[u].size(); ++i) {
+                uint32_t f = vertexFaces[u][i];
+                if (hasVertex(f, v)) {
+                    faceAlive[f] = 0;
+                    --liveFaces;
+                    for (int k = 0; k < 3; ++k) {
+                        std::vector<uint32_t>& list = vertexFaces[faces[3 * f + k]];
+                        if (faces[3 * f + k] != u) list.erase(std::find(list.begin(), list.end(), f));
+                    }
+                } else {
+                    for (int k = 0; k < 3; ++k) {
+                        if (faces[3 * f + k] == u) faces[3 * f + k] = v;
+                    }
+                    vertexFaces[v].push_back(f);
+                }
+            }
+            vertexFaces[u].clear();
+            parent[u] = v;
+            quadrics[v].add(quadrics[u]);
+            ++version[u];
+            ++version[v];
+
+            neighbors(v, linkV);
+            for (size_t i = 0; i < linkV.size(); ++i) {
+                push(linkV[i], v);
+                push(v, linkV[i]);
+            }
+        }
+
+        const glm::vec3* p;
+        std::vector<uint32_t> faces;
+        std::vector<char> faceAlive;
+        size_t liveFaces;
+        std::vector<std::vector<uint32_t>> vertexFaces;
+        std::vector<uint32_t> parent, version;
+        std::vector<Quadric> quadrics;
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> heap;
+        std::vector<uint32_t> linkU, linkV;
+    };
+
+    const glm::vec3* positions;
+    std::vector<LodLevel> levels;
+};
@@ -0,0 +1,485 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Shortest path propagation over meshes that do not fit in memory. preprocess() streams an OBJ file into a graph
+// file: vertices are renumbered along a Morton curve and cut into partitions of consecutive ids, so every partition
+// is a compact piece of the surface, and each partition stores the rows of its vertices, their edge lengths and
+// its boundary vertices (those with a neighbor in another partition). Only positions, the renumbering and per vertex
+// counters are held in memory while preprocessing.
+//
+// propagate() keeps one float per vertex and maps partitions on demand. The partition holding the smallest pending
+// distance is searched until its queue is empty; relaxations across its boundary are queued at the other partition.
+// Labels can improve after a partition was searched, which queues it again, so the result is exact (the same as
+// Dijkstra on the whole graph) at the cost of some repeated work. Mapped partitions are released least recently
+// used first to stay under the memory budget.
+class OutOfCoreMesh {
+   public:
+    struct Stats {
+        size_t settled;        // vertex scans, repeated ones included
+        size_t loads;          // partitions mapped
+        size_t evictions;      // partitions released to stay under budget
+        size_t bytesPaged;     // partition data mapped in
+        size_t peakResident;   // largest total of mapped partition data
+        size_t peakRss;        // of the whole process so far
+        size_t blocksRead;     // from storage by the whole process so far, 512-byte units
+        bool mapFailed;        // a partition could not be mapped, so propagate() returned no distances
+    };
+
+    OutOfCoreMesh()
+        : numVertices(0),
+          partitionSize(0),
+          numPartitions(0),
+          numBoundary(0),
+          budget(0),
+          prefix(nullptr),
+          prefixSize(0),
+          fd(-1),
+          table(nullptr),
+          newToOld(nullptr),
+          oldToNew(nullptr),
+          partitions(),
+          clock(0),
+          resident(0),
+          stats() {}
+
+    ~OutOfCoreMesh() { close(); }
+
+    // Writes the graph file for an OBJ file; polygons are split into fans. Faces with indices out of range are
+    // skipped. Returns false on I/O errors or if the file has no vertices.
+    static bool preprocess(const std::string& objPath, const std::string& path, size_t partitionSize = 65536) {
+        partitionSize = std::max<size_t>(partitionSize, 1);
+        std::vector<glm::vec3> positions;
+        if (!readVertices(objPath, positions) || positions.empty()) return false;
+        size_t n = positions.size();
+
+        // Morton order of the positions quantized to 21 bits along the longest side of the bounding box
+        std::vector<uint32_t> order(n);
+        {
+            glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+            for (size_t v = 0; v < n; ++v) {
+                lo = glm::min(lo, positions[v]);
+                hi = glm::max(hi, positions[v]);
+            }
+            glm::vec3 extent = hi - lo;
+            float scale = float((1 << 21) - 1) / std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-30f));
+            std::vector<std::pair<uint64_t, uint32_t>> keys(n);
+            for (size_t v = 0; v < n; ++v) {
+                glm::vec3 q = (positions[v] - lo) * scale;
+                uint64_t key = spread(uint32_t(q.x)) | spread(uint32_t(q.y)) << 1 | spread(uint32_t(q.z)) << 2;
+                keys[v] = std::make_pair(key, uint32_t(v));
+            }
+            std::sort(keys.begin(), keys.end());
+            for (size_t i = 0; i < n; ++i) order[i] = keys[i].second;
+        }
+        std::vector<uint32_t> rank(n);
+        for (size_t i = 0; i < n; ++i) rank[order[i]] = i;
+
+        // rows with duplicates go to a scratch file; cursor[v + 1] counts down from the end of row v to its start
+        std::vector<uint64_t> cursor(n + 2, 0);
+        bool ok = forEachTriangle(objPath, n, [&](uint32_t a, uint32_t b, uint32_t c) {
+            cursor[rank[a] + 1] += 2;
+            cursor[rank[b] + 1] += 2;
+            cursor[rank[c] + 1] += 2;
+        });
+        for (size_t v = 0; v <= n; ++v) cursor[v + 1] += cursor[v];
+        uint64_t total = cursor[n + 1];
+
+        std::string scratchPath = path + ".rows";
+        int scratchFd = ::open(scratchPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (scratchFd < 0) return false;
+        unlink(scratchPath.c_str());
+        uint32_t* rows = nullptr;
+        if (ok && total > 0 && ftruncate(scratchFd, total * sizeof(uint32_t)) == 0) {
+            void* data = mmap(nullptr, total * sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_SHARED, scratchFd, 0);
+            rows = data == MAP_FAILED ? nullptr : static_cast<uint32_t*>(data);
+        }
+        ::close(scratchFd);
+        if (total > 0 && !rows) return false;
+        ok = ok && forEachTriangle(objPath, n, [&](uint32_t a, uint32_t b, uint32_t c) {
+            uint32_t u = rank[a], v = rank[b], w = rank[c];
+            rows[--cursor[u + 1]] = v;
+            rows[--cursor[u + 1]] = w;
+            rows[--cursor[v + 1]] = w;
+            rows[--cursor[v + 1]] = u;
+            rows[--cursor[w + 1]] = u;
+            rows[--cursor[w + 1]] = v;
+        });
+        // now row v is [cursor[v + 1], cursor[v + 2])
+
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f) ok = false;
+        Header header;
+        memcpy(header.magic, kMagic, sizeof(header.magic));
+        header.numVertices = n;
+        header.partitionSize = partitionSize;
+        header.numPartitions = (n + partitionSize - 1) / partitionSize;
+        header.numBoundary = 0;
+        std::vector<Extent> extents(header.numPartitions);
+        uint64_t offset = align(sizeof(Header) + extents.size() * sizeof(Extent) + 2 * n * sizeof(uint32_t));
+        ok = ok && fseek(f, offset, SEEK_SET) == 0;
+
+        std::vector<uint32_t> offsets, neighbors, boundary;
+        std::vector<float> weights;
+        for (size_t p = 0; p < extents.size() && ok; ++p) {
+            uint32_t first = p * partitionSize, last = std::min<size_t>(first + partitionSize, n);
+            offsets.assign(1, 0);
+            neighbors.clear();
+            weights.clear();
+            boundary.clear();
+            for (uint32_t u = first; u < last; ++u) {
+                uint32_t* begin = rows + cursor[u + 1];
+                uint32_t* end = rows + cursor[u + 2];
+                std::sort(begin, end);
+                end = std::unique(begin, end);
+                bool crosses = false;
+                for (uint32_t* v = begin; v != end; ++v) {
+                    if (*v == u) continue;
+                    neighbors.push_back(*v);
+                    weights.push_back(glm::length(positions[order[*v]] - positions[order[u]]));
+                    crosses = crosses || *v < first || *v >= last;
+                }
+                offsets.push_back(neighbors.size());
+                if (crosses) boundary.push_back(u - first);
+            }
+            header.numBoundary += boundary.size();
+
+            PartitionHeader ph;
+            ph.numVertices = last - first;
+            ph.numEdges = neighbors.size();
+            ph.numBoundary = boundary.size();
+            ph.reserved = 0;
+            ok = ok && fwrite(&ph, sizeof(ph), 1, f) == 1;
+            ok = ok && fwrite(offsets.data(), sizeof(uint32_t), offsets.size(), f) == offsets.size();
+            ok = ok && fwrite(neighbors.data(), sizeof(uint32_t), neighbors.size(), f) == neighbors.size();
+            ok = ok && fwrite(weights.data(), sizeof(float), weights.size(), f) == weights.size();
+            ok = ok && fwrite(boundary.data(), sizeof(uint32_t), boundary.size(), f) == boundary.size();
+            extents[p].offset = offset;
+            extents[p].size = sizeof(ph) + (offsets.size() + neighbors.size() + boundary.size()) * sizeof(uint32_t) +
+                              weights.size() * sizeof(float);
+            offset = align(offset + extents[p].size);
+            ok = ok && fseek(f, offset, SEEK_SET) == 0;
+        }
+        if (rows) munmap(rows, total * sizeof(uint32_t));
+
+        ok = ok && fseek(f, 0, SEEK_SET) == 0;
+        ok = ok && fwrite(&header, sizeof(header), 1, f) == 1;
+        ok = ok && fwrite(extents.data(), sizeof(Extent), extents.size(), f) == extents.size();
+        ok = ok && fwrite(order.data(), sizeof(uint32_t), n, f) == n;
+        ok = ok && fwrite(rank.data(), sizeof(uint32_t), n, f) == n;
+        return f && fclose(f) == 0 && ok;
+    }
+
+    // Opens a graph file; partitions are mapped only while propagating, within budgetBytes (at least one is mapped
+    // whatever the budget).
+    bool open(const std::string& path, size_t budgetBytes) {
+        close();
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        Header header;
+        struct stat st;
+        if (pread(fd, &header, sizeof(header), 0) != ssize_t(sizeof(header)) || fstat(fd, &st) != 0 ||
+            memcmp(header.magic, kMagic, sizeof(header.magic)) != 0) {
+            close();
+            return false;
+        }
+        size_t size =
+            sizeof(Header) + header.numPartitions * sizeof(Extent) + 2 * size_t(header.numVertices) * sizeof(uint32_t);
+        void* data = size_t(st.st_size) >= size ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        if (data == MAP_FAILED) {
+            close();
+            return false;
+        }
+
+        prefix = data;
+        prefixSize = size;
+        numVertices = header.numVertices;
+        partitionSize = header.partitionSize;
+        numPartitions = header.numPartitions;
+        numBoundary = header.numBoundary;
+        budget = budgetBytes;
+        const char* bytes = static_cast<const char*>(data) + sizeof(Header);
+        table = reinterpret_cast<const Extent*>(bytes);
+        newToOld = reinterpret_cast<const uint32_t*>(bytes + numPartitions * sizeof(Extent));
+        oldToNew = newToOld + numVertices;
+        partitions.assign(numPartitions, Partition());
+        return true;
+    }
+
+    void close() {
+        for (size_t p = 0; p < partitions.size(); ++p) release(p);
+        partitions.clear();
+        if (prefix) munmap(prefix, prefixSize);
+        prefix = nullptr;
+        prefixSize = 0;
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        numVertices = numPartitions = numBoundary = 0;
+        table = nullptr;
+        newToOld = oldToNew = nullptr;
+    }
+
+    // Distances from vertex src (numbered as in the OBJ file) to all vertices, in the same numbering. Empty if no
+    // graph file is open, src is out of range or a partition could not be mapped (see Stats::mapFailed).
+    std::vector<float> propagate(uint32_t src) {
+        const float kInf = std::numeric_limits<float>::max();
+        typedef std::pair<float, uint32_t> Entry;
+        std::greater<Entry> later;
+        stats = Stats();
+        stats.peakResident = resident;
+        if (!prefix || src >= numVertices) return std::vector<float>();
+
+        std::vector<float> dist(numVertices, kInf);
+        std::vector<std::vector<Entry>> pending(numPartitions);
+        std::vector<float> pendingMin(numPartitions, kInf);
+        std::vector<Entry> queue, heap;  // partitions by smallest pending distance; vertices of one partition
+        uint32_t s = oldToNew[src];
+        dist[s] = 0.f;
+        pending[s / partitionSize].push_back(Entry(0.f, s));
+        pendingMin[s / partitionSize] = 0.f;
+        queue.push_back(Entry(0.f, s / partitionSize));
+
+        while (!queue.empty()) {
+            std::pop_heap(queue.begin(), queue.end(), later);
+            Entry top = queue.back();
+            queue.pop_back();
+            uint32_t p = top.second;
+            if (pending[p].empty() || top.first != pendingMin[p]) continue;  // stale entry
+
+            const Partition* mapped = acquire(p);
+            if (!mapped) {
+                stats.mapFailed = true;
+                return std::vector<float>();
+            }
+            const Partition& part = *mapped;
+            uint32_t first = p * partitionSize, last = first + part.header->numVertices;
+            heap.swap(pending[p]);
+            pending[p].clear();
+            pendingMin[p] = kInf;
+            std::make_heap(heap.begin(), heap.end(), later);
+            while (!heap.empty()) {
+                std::pop_heap(heap.begin(), heap.end(), later);
+                float d = heap.back().first;
+                uint32_t u = heap.back().second;
+                heap.pop_back();
+                if (d > dist[u]) continue;
+                ++stats.settled;
+                for (uint32_t e = part.offsets[u - first]; e < part.offsets[u - first + 1]; ++e) {
+                    uint32_t v = part.neighbors[e];
+                    float alt = d + part.weights[e];
+                    if (alt >= dist[v]) continue;
+                    dist[v] = alt;
+                    if (v >= first && v < last) {
+                        heap.push_back(Entry(alt, v));
+                        std::push_heap(heap.begin(), heap.end(), later);
+                        continue;
+                    }
+                    uint32_t q = v / partitionSize;
+                    pending[q].push_back(Entry(alt, v));
+                    if (alt < pendingMin[q]) {
+                        pendingMin[q] = alt;
+                        queue.push_back(Entry(alt, q));
+                        std::push_heap(queue.begin(), queue.end(), later);
+                    }
+                }
+            }
+        }
+
+        std::vector<float> result(numVertices);
+        for (size_t v = 0; v < numVertices; ++v) result[newToOld[v]] = dist[v];
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+            stats.peakRss = size_t(usage.ru_maxrss) * 1024;
+            stats.blocksRead = usage.ru_inblock;
+        }
+        return result;
+    }
+
+    // Counters of the last propagation.
+    const Stats& getStats() const { return stats; }
+
+    size_t size() const { return numVertices; }
+    size_t getNumPartitions() const { return numPartitions; }
+    size_t getNumBoundary() const { return numBoundary; }
+
+   private:
+    OutOfCoreMesh(const OutOfCoreMesh&);
+    OutOfCoreMesh& operator=(const OutOfCoreMesh&);
+
+    struct Header {
+        char magic[8];
+        uint32_t numVertices;
+        uint32_t partitionSize;
+        uint32_t numPartitions;
+        uint32_t numBoundary;
+    };
+    static constexpr const char* kMagic = "GEOOOC01";
+
+    // Location of a partition in the file; partitions start at multiples of kAlignment so they can be mapped alone.
+    struct Extent {
+        uint64_t offset, size;
+    };
+    static const uint64_t kAlignment = 65536;
+
+    // Followed by numVertices + 1 row offsets, numEdges neighbors and weights, and numBoundary indices in the
+    // partition.
+    struct PartitionHeader {
+        uint32_t numVertices, numEdges, numBoundary, reserved;
+    };
+
+    struct Partition {
+        Partition() : data(nullptr), size(0), lastUse(0), header(nullptr), offsets(), neighbors(), weights() {}
+        void* data;
+        size_t size;
+        uint64_t lastUse;
+        const PartitionHeader* header;
+        const uint32_t* offsets;
+        const uint32_t* neighbors;
+        const float* weights;
+    };
+
+    static uint64_t align(uint64_t offset) { return (offset + kAlignment - 1) / kAlignment * kAlignment; }
+
+    // Spreads the low 21 bits of x to every third bit.
+    static uint64_t spread(uint32_t x) {
+        uint64_t v = x & 0x1fffff;
+        v = (v | v << 32) & 0x1f00000000ffffULL;
+        v = (v | v << 16) & 0x1f0000ff0000ffULL;
+        v = (v | v << 8) & 0x100f00f00f00f00fULL;
+        v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+        v = (v | v << 2) & 0x1249249249249249ULL;
+        return v;
+    }
+
+    static bool readVertices(const std::string& objPath, std::vector<glm::vec3>& positions) {
+        FILE* f = fopen(objPath.c_str(), "r");
+        if (!f) return false;
+        char* line = nullptr;
+        size_t capacity = 0;
+        while (getline(&line, &capacity, f) >= 0) {
+            if (line[0] != 'v' || (line[1] != ' ' && line[1] != '\t')) continue;
+            char* p = line + 2;
+            glm::vec3 v;
+            for (int k = 0; k < 3; ++k) v[k] = strtof(p, &p);
+            positions.push_back(v);
+        }
+        free(line);
+        fclose(f);
+        return true;
+    }
+
+    // Calls triangle(a, b, c) with 0-based vertex indices for every face of the OBJ file, split into a fan.
+    template <typename Triangle>
+    static bool forEachTriangle(const std::string& objPath, size_t numVertices, Triangle triangle) {
+        FILE* f = fopen(objPath.c_str(), "r");
+        if (!f) return false;
+        char* line = nullptr;
+        size_t capacity = 0;
+        long seen = 0;  // vertices so far, for negative indices
+        std::vector<uint32_t> polygon;
+        while (getline(&line, &capacity, f) >= 0) {
+            if (line[0] == 'v' && (line[1] == ' ' || line[1] == '\t')) ++seen;
+            if (line[0] != 'f' || (line[1] != ' ' && line[1] != '\t')) continue;
+            polygon.clear();
+            bool valid = true;
+            char* p = line + 1;
+            while (true) {
+                while (*p == ' ' || *p == '\t') ++p;
+                if (*p == '\0' || *p == '\n' || *p == '\r') break;
+                char* end;
+                long index = strtol(p, &end, 10);
+                if (end == p) {
+                    valid = false;
+                    break;
+                }
+                index = index < 0 ? seen + index : index - 1;
+                valid = valid && index >= 0 && size_t(index) < numVertices;
+                polygon.push_back(uint32_t(index));
+                p = end;
+                while (*p && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') ++p;  // texcoord and normal
+            }
+            if (!valid) continue;
+            for (size_t k = 2; k < polygon.size(); ++k) triangle(polygon[0], polygon[k - 1], polygon[k]);
+        }
+        free(line);
+        fclose(f);
+        return true;
+    }
+
+    // Maps partition p, releasing the least recently used ones while over budget. Null if mmap fails.
+    const Partition* acquire(uint32_t p) {
+        Partition& part = partitions[p];
+        part.lastUse = ++clock;
+        if (part.data) return &part;
+
+        size_t size = table[p].size;
+        while (resident > 0 && resident + size > budget) {
+            size_t oldest = p;
+            for (size_t q = 0; q < partitions.size(); ++q) {
+                if (partitions[q].data && (oldest == p || partitions[q].lastUse < partitions[oldest].lastUse)) {
+                    oldest = q;
+                }
+            }
+            release(oldest);
+            ++stats.evictions;
+        }
+
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE;
+#endif
+        void* data = mmap(nullptr, size, PROT_READ, flags, fd, table[p].offset);
+        if (data == MAP_FAILED) return nullptr;
+        part.data = data;
+        part.size = size;
+        part.header = static_cast<const PartitionHeader*>(data);
+        part.offsets = reinterpret_cast<const uint32_t*>(part.header + 1);
+        part.neighbors = part.offsets + part.header->numVertices + 1;
+        part.weights = reinterpret_cast<const float*>(part.neighbors + part.header->numEdges);
+        resident += size;
+        stats.peakResident = std::max(stats.peakResident, resident);
+        stats.bytesPaged += size;
+        ++stats.loads;
+        return &part;
+    }
+
+    void release(size_t p) {
+        Partition& part = partitions[p];
+        if (!part.data) return;
+        munmap(part.data, part.size);
+        resident -= part.size;
+        part = Partition();
+    }
+
+    size_t numVertices, partitionSize, numPartitions, numBoundary;
+    size_t budget;
+
+    void* prefix;  // header, partition table and renumbering
+    size_t prefixSize;
+    int fd;
+    const Extent* table;
+    const uint32_t* newToOld;
+    const uint32_t* oldToNew;
+
+    std::vector<Partition> partitions;
+    uint64_t clock;   // for least recently used
+    size_t resident;  // bytes of mapped partitions
+    Stats stats;
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent pool of hardware_concurrency() - 1 workers; the dispatching thread works alongside them. Calls made
+// from inside a running job, or while another thread is dispatching, run serially on the calling thread.
+class ThreadPool {
+   public:
+    static ThreadPool& instance() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    size_t size() const { return workers.size() + 1; }
+
+    void run(size_t n, size_t grain, const std::function<void(size_t, size_t)>& body) {
+        grain = std::max<size_t>(grain, 1);
+        std::unique_lock<std::mutex> dispatchLock(dispatch, std::defer_lock);
+        if (n <= grain || workers.empty() || insideJob() || !dispatchLock.try_lock()) {
+            for (size_t begin = 0; begin < n; begin += grain) body(begin, std::min(n, begin + grain));
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &body;
+            jobSize = n;
+            jobGrain = grain;
+            nextBlock = 0;
+            pending = workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+
+        insideJob() = true;
+        work();
+        insideJob() = false;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+   private:
+    ThreadPool() : job(nullptr), jobSize(0), jobGrain(1), nextBlock(0), pending(0), generation(0), stop(false) {
+        unsigned n = std::thread::hardware_concurrency();
+        for (unsigned i = 1; i < n; ++i) workers.push_back(std::thread(&ThreadPool::loop, this));
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+    }
+
+    static bool& insideJob() {
+        static thread_local bool flag = false;
+        return flag;
+    }
+
+    void loop() {
+        insideJob() = true;
+        size_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stop || generation != seen; });
+                if (stop) return;
+                seen = generation;
+            }
+            work();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0) done.notify_one();
+            }
+        }
+    }
+
+    void work() {
+        for (;;) {
+            size_t begin = nextBlock.fetch_add(1) * jobGrain;
+            if (begin >= jobSize) return;
+            (*job)(begin, std::min(jobSize, begin + jobGrain));
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex dispatch;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+
+    const std::function<void(size_t, size_t)>* job;
+    size_t jobSize, jobGrain;
+    std::atomic<size_t> nextBlock;
+    size_t pending;
+    size_t generation;
+    bool stop;
+};
+
+// Calls body(begin, end) for consecutive blocks of at most grain items covering [0, n), in parallel.
+inline void parallelFor(size_t n, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    ThreadPool::instance().run(n, grain, body);
+}
+
+inline size_t numThreads() { return ThreadPool::instance().size(); }
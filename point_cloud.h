@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "edge_graph.h"
+#include "kd_tree.h"
+#include "mesh.h"
+#include "parallel.h"
+
+// Unit normal of the least squares plane through count points: the eigenvector of their covariance matrix with the
+// smallest eigenvalue, found with the closed form eigenvalues of a symmetric 3x3 matrix. Zero if the points do not
+// determine a plane, e.g. when they are collinear.
+inline glm::vec3 fitPlaneNormal(const glm::vec3* points, const uint32_t* ids, size_t count) {
+    if (count < 3) return glm::vec3(0.f);
+    glm::vec3 mean(0.f);
+    for (size_t i = 0; i < count; ++i) mean += points[ids[i]];
+    mean /= float(count);
+    float a00 = 0.f, a01 = 0.f, a02 = 0.f, a11 = 0.f, a12 = 0.f, a22 = 0.f;
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 d = points[ids[i]] - mean;
+        a00 += d[0] * d[0];
+        a01 += d[0] * d[1];
+        a02 += d[0] * d[2];
+        a11 += d[1] * d[1];
+        a12 += d[1] * d[2];
+        a22 += d[2] * d[2];
+    }
+
+    float q = (a00 + a11 + a22) / 3.f;
+    float p1 = a01 * a01 + a02 * a02 + a12 * a12;
+    float p2 = (a00 - q) * (a00 - q) + (a11 - q) * (a11 - q) + (a22 - q) * (a22 - q) + 2.f * p1;
+    float p = std::sqrt(p2 / 6.f);
+    if (!(p > 0.f)) return glm::vec3(0.f);  // isotropic
+    float b00 = (a00 - q) / p, b11 = (a11 - q) / p, b22 = (a22 - q) / p, b01 = a01 / p, b02 = a02 / p, b12 = a12 / p;
+    float r = 0.5f * (b00 * (b11 * b22 - b12 * b12) - b01 * (b01 * b22 - b12 * b02) + b02 * (b01 * b12 - b11 * b02));
+    float phi = std::acos(std::min(std::max(r, -1.f), 1.f)) / 3.f;
+    float smallest = q + 2.f * p * std::cos(phi + 2.f * float(M_PI) / 3.f);
+
+    // the eigenvector is orthogonal to the rows of A - smallest I; take the best conditioned cross product of two
+    glm::vec3 r0(a00 - smallest, a01, a02), r1(a01, a11 - smallest, a12), r2(a02, a12, a22 - smallest);
+    glm::vec3 c[3] = {glm::cross(r0, r1), glm::cross(r0, r2), glm::cross(r1, r2)};
+    float best = 0.f;
+    glm::vec3 normal(0.f);
+    for (int i = 0; i < 3; ++i) {
+        float length2 = glm::dot(c[i], c[i]);
+        if (length2 > best) {
+            best = length2;
+            normal = c[i];
+        }
+    }
+    // a second eigenvalue close to the smallest leaves the plane undetermined
+    float scale = std::max(std::max(glm::dot(r0, r0), glm::dot(r1, r1)), glm::dot(r2, r2));
+    if (!(best > 1e-8f * scale * scale)) return glm::vec3(0.f);
+    return normal / std::sqrt(best);
+}
+
+// Symmetric k-nearest-neighbor graph of a point cloud: u and v are adjacent if either is among the k nearest points
+// of the other, weighted by their distance. Neighbors are found with a KdTree, in parallel over blocks of points taken
+// in tree order so that consecutive queries visit the same leaves.
+//
+// With maxSine below 1 an edge is also dropped if it leaves the tangent plane of either endpoint, fitted to its k
+// neighbors, at an angle whose sine exceeds maxSine. That keeps thin sheets and close parallel surfaces, which share
+// many nearest neighbors, from being joined across the gap.
+inline void buildKnnGraph(const glm::vec3* points, size_t n, size_t k, EdgeGraph& graph, float maxSine = 1.f) {
+    const uint32_t kNone = std::numeric_limits<uint32_t>::max(), kPruned = kNone - 1;
+    KdTree tree;
+    tree.build(points, n);
+    const std::vector<uint32_t>& order = tree.getOrder();
+
+    // knn[k * u, k * (u + 1)) are the k nearest other points of u, padded with kNone if there are fewer
+    std::vector<uint32_t> knn(k * n, kNone);
+    parallelFor(n, 1024, [&](size_t begin, size_t end) {
+        std::vector<std::pair<uint32_t, float>> nearest;
+        for (size_t i = begin; i < end; ++i) {
+            uint32_t u = order[i];
+            tree.nearest(points[u], k + 1, nearest);
+            size_t count = 0;
+            for (size_t j = 0; j < nearest.size() && count < k; ++j) {
+                if (nearest[j].first != u) knn[k * u + count++] = nearest[j].first;
+            }
+        }
+    });
+
+    if (maxSine < 1.f) {
+        std::vector<glm::vec3> normals(n);
+        parallelFor(n, 1024, [&](size_t begin, size_t end) {
+            for (size_t u = begin; u < end; ++u) {
+                const uint32_t* row = &knn[k * u];
+                normals[u] = fitPlaneNormal(points, row, std::find(row, row + k, kNone) - row);
+            }
+        });
+        parallelFor(n, 1024, [&](size_t begin, size_t end) {
+            for (size_t u = begin; u < end; ++u) {
+                for (uint32_t* v = &knn[k * u]; v != &knn[k * u] + k && *v != kNone; ++v) {
+                    glm::vec3 d = points[*v] - points[u];
+                    float bound = maxSine * glm::length(d);
+                    if (std::abs(glm::dot(normals[u], d)) > bound || std::abs(glm::dot(normals[*v], d)) > bound) {
+                        *v = kPruned;
+                    }
+                }
+            }
+        });
+    }
+
+    // rows hold both directions of every kept edge; duplicates from mutual neighbors are removed per row
+    graph.offsets.assign(n + 1, 0);
+    for (size_t u = 0; u < n; ++u) {
+        for (size_t j = 0; j < k && knn[k * u + j] != kNone; ++j) {
+            uint32_t v = knn[k * u + j];
+            if (v == kPruned) continue;
+            ++graph.offsets[u + 1];
+            ++graph.offsets[v + 1];
+        }
+    }
+    for (size_t u = 0; u < n; ++u) graph.offsets[u + 1] += graph.offsets[u];
+    graph.neighbors.resize(graph.offsets[n]);
+    {
+        std::vector<uint32_t> fill(graph.offsets.begin(), graph.offsets.end() - 1);
+        for (size_t u = 0; u < n; ++u) {
+            for (size_t j = 0; j < k && knn[k * u + j] != kNone; ++j) {
+                uint32_t v = knn[k * u + j];
+                if (v == kPruned) continue;
+                graph.neighbors[fill[u]++] = v;
+                graph.neighbors[fill[v]++] = u;
+            }
+        }
+    }
+    std::vector<uint32_t>().swap(knn);
+
+    std::vector<uint32_t> rowSize(n);
+    parallelFor(n, 4096, [&](size_t begin, size_t end) {
+        for (size_t u = begin; u < end; ++u) {
+            uint32_t* first = graph.neighbors.data() + graph.offsets[u];
+            uint32_t* last = graph.neighbors.data() + graph.offsets[u + 1];
+            std::sort(first, last);
+            rowSize[u] = std::unique(first, last) - first;
+        }
+    });
+    uint32_t out = 0;
+    for (size_t u = 0; u < n; ++u) {
+        std::copy(graph.neighbors.begin() + graph.offsets[u], graph.neighbors.begin() + graph.offsets[u] + rowSize[u],
+                  graph.neighbors.begin() + out);
+        graph.offsets[u] = out;
+        out += rowSize[u];
+    }
+    graph.offsets[n] = out;
+    graph.neighbors.resize(out);
+    graph.neighbors.shrink_to_fit();
+
+    graph.weights.resize(out);
+    graph.updateWeights(points);
+}
+
+// The points of cloud, without faces, with their k-nearest-neighbor graph as the edge graph, so the graph based
+// algorithms run on scans unchanged.
+inline std::shared_ptr<const Mesh> pointCloudMesh(const Mesh& cloud, size_t k, float maxSine = 1.f) {
+    EdgeGraph graph;
+    buildKnnGraph(cloud.positions().data(), cloud.numVertices(), k, graph, maxSine);
+    return std::make_shared<const Mesh>(cloud.positions(), std::vector<uint32_t>(), std::move(graph));
+}
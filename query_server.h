@@ -0,0 +1,554 @@
+#pragma once
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "distance_dijkstra.h"
+
+// Wire format of the query server. A request is a QueryRequest followed by count vertex ids (2 * count for
+// point-to-point: source and target of each pair). The reply is a QueryResponse; its payload is the first bytes
+// bytes of the shared memory object named shm, which belongs to the connection and is reused by later replies.
+enum QueryType {
+    QUERY_SINGLE_SOURCE,   // count 1; one float per vertex
+    QUERY_MULTI_SOURCE,    // distance to the nearest of count sources; one float per vertex
+    QUERY_BOUNDED,         // count 1 and radius; QueryHit per vertex within radius, nearest first
+    QUERY_POINT_TO_POINT,  // count pairs; one float per pair
+    QUERY_STATS,           // count 0; LatencyHistogram per query type, this one included
+    QUERY_TYPES,
+};
+
+enum QueryStatus {
+    QUERY_OK,
+    QUERY_BAD_REQUEST,
+    QUERY_BAD_MESH,
+    QUERY_BAD_VERTEX,
+    QUERY_FAILED,
+};
+
+struct QueryRequest {
+    uint32_t type, mesh, count;
+    float radius;
+};
+
+struct QueryResponse {
+    uint32_t status, reserved;
+    uint64_t bytes;
+    char shm[48];
+};
+
+struct QueryHit {
+    uint32_t vertex;
+    float distance;
+};
+
+// Time from reading a request to sending its reply. Bucket b counts latencies in [2^b, 2^(b+1)) microseconds,
+// bucket 0 also those under a microsecond.
+struct LatencyHistogram {
+    static const size_t kBuckets = 32;
+    uint64_t count, totalMicroseconds;
+    uint64_t buckets[kBuckets];
+};
+
+// Daemon that keeps meshes and their search structures loaded and answers queries over a Unix domain socket. One
+// thread polls the socket and reads requests from non-blocking connections, buffering a partial request per
+// connection until the rest arrives, so a slow client holds up no one else; a pool of workers answers them and
+// writes the results into shared memory. A single-source request is answered together with the waiting
+// single-source requests whose sources lie near it on the same mesh, up to maxBatch of them, by one multi-source
+// traversal; that only pays off for nearby sources, since far apart ones make the traversal correct its labels
+// repeatedly. A connection has one request in flight at a time.
+class QueryServer {
+   public:
+    static const uint32_t kMaxCount = 1 << 20;  // ids per request
+
+    explicit QueryServer(size_t numWorkers = std::thread::hardware_concurrency(), size_t maxBatch = 16)
+        : meshes(),
+          batchRadius(),
+          listenFd(-1),
+          socketPath(),
+          numWorkers(std::max<size_t>(numWorkers, 1)),
+          maxBatch(std::max<size_t>(maxBatch, 1)),
+          nextConnection(0),
+          stopping(false),
+          mutex(),
+          ready(),
+          jobs(),
+          latencies() {
+        wakeFds[0] = wakeFds[1] = -1;
+        if (pipe(wakeFds) == 0) {
+            fcntl(wakeFds[0], F_SETFL, O_NONBLOCK);
+            fcntl(wakeFds[1], F_SETFL, O_NONBLOCK);
+        } else {
+            wakeFds[0] = wakeFds[1] = -1;
+        }
+        for (size_t t = 0; t < QUERY_TYPES; ++t) latencies[t].reset();
+    }
+
+    ~QueryServer() {
+        if (listenFd >= 0) {
+            close(listenFd);
+            unlink(socketPath.c_str());
+        }
+        if (wakeFds[0] >= 0) close(wakeFds[0]);
+        if (wakeFds[1] >= 0) close(wakeFds[1]);
+    }
+
+    // Meshes are numbered in the order they are added; add them all before run().
+    uint32_t addMesh(std::unique_ptr<const DijkstraAlgorithm> mesh) {
+        const Mesh& m = *mesh->getMesh();
+        batchRadius.push_back(0.05f * glm::length(m.boundsMax() - m.boundsMin()));
+        meshes.push_back(std::shared_ptr<const DijkstraAlgorithm>(std::move(mesh)));
+        return meshes.size() - 1;
+    }
+
+    // Binds the socket, replacing a stale one left at path.
+    bool listen(const std::string& path) {
+        sockaddr_un address;
+        if (path.size() >= sizeof(address.sun_path) || wakeFds[0] < 0) return false;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.c_str(), path.size());
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0) return false;
+        unlink(path.c_str());
+        sockaddr* bound = reinterpret_cast<sockaddr*>(&address);
+        if (bind(listenFd, bound, sizeof(address)) != 0 || ::listen(listenFd, 64) != 0) {
+            close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        socketPath = path;
+        return true;
+    }
+
+    // Serves until stop() is called.
+    void run() {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < numWorkers; ++i) workers.push_back(std::thread(&QueryServer::work, this));
+
+        std::vector<std::shared_ptr<Connection>> connections;
+        std::vector<pollfd> fds;
+        while (!stopping.load()) {
+            fds.clear();
+            pollfd wake = {wakeFds[0], POLLIN, 0}, incoming = {listenFd, POLLIN, 0};
+            fds.push_back(wake);
+            fds.push_back(incoming);
+            std::vector<std::shared_ptr<Connection>> polled;
+            for (size_t i = 0; i < connections.size(); ++i) {
+                if (connections[i]->busy.load()) continue;
+                pollfd p = {connections[i]->fd, POLLIN, 0};
+                fds.push_back(p);
+                polled.push_back(connections[i]);
+            }
+            if (poll(fds.data(), fds.size(), -1) < 0) continue;
+
+            if (fds[0].revents) {
+                char buffer[64];
+                while (read(wakeFds[0], buffer, sizeof(buffer)) > 0) {
+                }
+            }
+            if (fds[1].revents & POLLIN) {
+                int fd = accept(listenFd, nullptr, nullptr);
+                if (fd >= 0 && fcntl(fd, F_SETFL, O_NONBLOCK) == 0) {
+                    connections.push_back(std::make_shared<Connection>(fd, nextConnection++));
+                } else if (fd >= 0) {
+                    close(fd);
+                }
+            }
+            for (size_t i = 0; i < polled.size(); ++i) {
+                if (!fds[i + 2].revents) continue;
+                if (!receive(polled[i])) {
+                    connections.erase(std::find(connections.begin(), connections.end(), polled[i]));
+                }
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.clear();
+        }
+        ready.notify_all();
+        for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+    }
+
+    // May be called from any thread, including a signal handler.
+    void stop() {
+        stopping.store(true);
+        char c = 0;
+        ssize_t ignored = write(wakeFds[1], &c, 1);
+        (void)ignored;
+    }
+
+    LatencyHistogram histogram(QueryType type) const {
+        LatencyHistogram h;
+        latencies[type].load(h);
+        return h;
+    }
+
+   private:
+    QueryServer(const QueryServer&);
+    QueryServer& operator=(const QueryServer&);
+
+    typedef std::chrono::steady_clock Clock;
+
+    // Socket and reply buffer of one client.
+    struct Connection {
+        Connection(int fd, uint64_t serial)
+            : fd(fd), busy(false), input(), received(0), shmName(), shmFd(-1), shm(nullptr), shmSize(0) {
+            char name[sizeof(QueryResponse().shm)];
+            snprintf(name, sizeof(name), "/geodesics-%d-%llu", int(getpid()), (unsigned long long)serial);
+            shmName = name;
+        }
+
+        ~Connection() {
+            close(fd);
+            if (shm) munmap(shm, shmSize);
+            if (shmFd >= 0) {
+                close(shmFd);
+                shm_unlink(shmName.c_str());
+            }
+        }
+
+        // Grows the shared memory to at least bytes; returns its start or null.
+        void* reserve(size_t bytes) {
+            if (shmFd < 0) {
+                shmFd = shm_open(shmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+                if (shmFd < 0) return nullptr;
+            }
+            if (bytes <= shmSize && shm) return shm;
+            size_t size = std::max<size_t>(std::max<size_t>(bytes, 2 * shmSize), 1 << 16);
+            if (shm) munmap(shm, shmSize);
+            shm = nullptr;
+            shmSize = 0;
+            if (ftruncate(shmFd, size) != 0) return nullptr;
+            void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, shmFd, 0);
+            if (data == MAP_FAILED) return nullptr;
+            shm = data;
+            shmSize = size;
+            return shm;
+        }
+
+        int fd;
+        std::atomic<bool> busy;  // a request is being answered; not polled meanwhile
+        std::vector<char> input;  // the request being read, only by the polling thread
+        size_t received;          // bytes of it so far
+        std::string shmName;
+        int shmFd;
+        void* shm;
+        size_t shmSize;
+    };
+
+    struct Job {
+        std::shared_ptr<Connection> connection;
+        QueryRequest request;
+        std::vector<uint32_t> ids;
+        Clock::time_point received;
+    };
+
+    struct Histogram {
+        std::atomic<uint64_t> count, totalMicroseconds;
+        std::atomic<uint64_t> buckets[LatencyHistogram::kBuckets];
+
+        void reset() {
+            count.store(0);
+            totalMicroseconds.store(0);
+            for (size_t b = 0; b < LatencyHistogram::kBuckets; ++b) buckets[b].store(0);
+        }
+
+        void add(uint64_t microseconds) {
+            size_t b = 0;
+            while (b + 1 < LatencyHistogram::kBuckets && microseconds >> (b + 1)) ++b;
+            buckets[b].fetch_add(1, std::memory_order_relaxed);
+            totalMicroseconds.fetch_add(microseconds, std::memory_order_relaxed);
+            count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void load(LatencyHistogram& h) const {
+            h.count = count.load(std::memory_order_relaxed);
+            h.totalMicroseconds = totalMicroseconds.load(std::memory_order_relaxed);
+            for (size_t b = 0; b < LatencyHistogram::kBuckets; ++b) {
+                h.buckets[b] = buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+    };
+
+    // Reads whatever has arrived of the next request, never past its end, and queues it once complete, or answers it
+    // at once if it is malformed. Returns false when the client is gone.
+    bool receive(const std::shared_ptr<Connection>& connection) {
+        Connection& c = *connection;
+        QueryRequest r;
+        for (;;) {
+            size_t size = sizeof(r);
+            if (c.received >= sizeof(r)) {
+                memcpy(&r, c.input.data(), sizeof(r));
+                if (r.type >= QUERY_TYPES || r.count > kMaxCount) {
+                    reply(c, QUERY_BAD_REQUEST, 0);
+                    return false;  // the rest of the stream cannot be parsed
+                }
+                size += (r.type == QUERY_POINT_TO_POINT ? 2 : 1) * size_t(r.count) * sizeof(uint32_t);
+            }
+            if (c.received == size) break;
+            c.input.resize(size);
+            ssize_t got = recv(c.fd, &c.input[c.received], size - c.received, 0);
+            if (got > 0) {
+                c.received += got;
+            } else if (got < 0 && errno == EINTR) {
+                continue;
+            } else {
+                return got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);  // the rest comes later
+            }
+        }
+
+        Job job;
+        job.connection = connection;
+        job.request = r;
+        job.received = Clock::now();
+        job.ids.resize((c.received - sizeof(r)) / sizeof(uint32_t));
+        if (!job.ids.empty()) memcpy(job.ids.data(), &c.input[sizeof(r)], job.ids.size() * sizeof(uint32_t));
+        c.received = 0;
+
+        QueryStatus status = validate(job);
+        if (status != QUERY_OK) return reply(c, status, 0);
+        c.busy.store(true);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        ready.notify_one();
+        return true;
+    }
+
+    QueryStatus validate(const Job& job) const {
+        const QueryRequest& r = job.request;
+        if (r.type == QUERY_STATS) return r.count == 0 ? QUERY_OK : QUERY_BAD_REQUEST;
+        bool countOk = r.type == QUERY_SINGLE_SOURCE || r.type == QUERY_BOUNDED ? r.count == 1 : r.count > 0;
+        if (!countOk || (r.type == QUERY_BOUNDED && !(r.radius >= 0.f))) return QUERY_BAD_REQUEST;
+        if (r.mesh >= meshes.size()) return QUERY_BAD_MESH;
+        size_t n = meshes[r.mesh]->getVertices().size();
+        for (size_t i = 0; i < job.ids.size(); ++i) {
+            if (job.ids[i] >= n) return QUERY_BAD_VERTEX;
+        }
+        return QUERY_OK;
+    }
+
+    bool reply(Connection& connection, QueryStatus status, size_t bytes) {
+        QueryResponse response;
+        memset(&response, 0, sizeof(response));
+        response.status = status;
+        response.bytes = bytes;
+        memcpy(response.shm, connection.shmName.c_str(), connection.shmName.size() + 1);
+        return send(connection.fd, &response, sizeof(response), MSG_NOSIGNAL) == ssize_t(sizeof(response));
+    }
+
+    // Replies to a queued job and lets the connection be polled again. A client that does not take its reply is
+    // disconnected; the polling thread then finds the socket closed.
+    void finish(Job& job, QueryStatus status, size_t bytes) {
+        if (!reply(*job.connection, status, bytes)) shutdown(job.connection->fd, SHUT_RDWR);
+        uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - job.received).count();
+        latencies[job.request.type].add(elapsed);
+        job.connection->busy.store(false);
+        char c = 0;
+        ssize_t ignored = write(wakeFds[1], &c, 1);
+        (void)ignored;
+    }
+
+    // Takes the oldest job, and with a single-source one the single-source jobs for the same mesh whose source is
+    // within batchRadius of its source.
+    bool take(std::vector<Job>& batch) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return !jobs.empty() || stopping.load(); });
+        if (jobs.empty()) return false;
+        batch.clear();
+        batch.push_back(std::move(jobs.front()));
+        jobs.pop_front();
+        const QueryRequest first = batch[0].request;
+        if (first.type != QUERY_SINGLE_SOURCE) return true;
+        const std::vector<glm::vec3>& p = meshes[first.mesh]->getVertices();
+        const glm::vec3 center = p[batch[0].ids[0]];
+        for (std::deque<Job>::iterator it = jobs.begin(); it != jobs.end() && batch.size() < maxBatch;) {
+            if (it->request.type == QUERY_SINGLE_SOURCE && it->request.mesh == first.mesh &&
+                glm::length(p[it->ids[0]] - center) <= batchRadius[first.mesh]) {
+                batch.push_back(std::move(*it));
+                it = jobs.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        return true;
+    }
+
+    void work() {
+        std::vector<Job> batch;
+        std::vector<float> dist;
+        std::vector<uint32_t> pred;
+        std::vector<std::pair<uint32_t, float>> hits;
+        DijkstraAlgorithm::Workspace workspace;
+        while (take(batch)) {
+            Job& job = batch[0];
+            const QueryRequest& r = job.request;
+            if (r.type == QUERY_STATS) {
+                size_t bytes = QUERY_TYPES * sizeof(LatencyHistogram);
+                LatencyHistogram* out = static_cast<LatencyHistogram*>(job.connection->reserve(bytes));
+                for (size_t t = 0; out && t < QUERY_TYPES; ++t) latencies[t].load(out[t]);
+                finish(job, out ? QUERY_OK : QUERY_FAILED, bytes);
+                continue;
+            }
+
+            const DijkstraAlgorithm& mesh = *meshes[r.mesh];
+            size_t n = mesh.getVertices().size();
+            if (r.type == QUERY_SINGLE_SOURCE && batch.size() > 1) {
+                std::vector<uint32_t> sources;
+                for (size_t i = 0; i < batch.size(); ++i) sources.push_back(batch[i].ids[0]);
+                mesh.distancesFrom(sources.data(), sources.size(), dist);
+                for (size_t i = 0; i < batch.size(); ++i) {
+                    float* out = static_cast<float*>(batch[i].connection->reserve(n * sizeof(float)));
+                    for (size_t v = 0; out && v < n; ++v) out[v] = dist[v * batch.size() + i];
+                    finish(batch[i], out ? QUERY_OK : QUERY_FAILED, n * sizeof(float));
+                }
+                continue;
+            }
+
+            void* out = nullptr;
+            size_t bytes = 0;
+            if (r.type == QUERY_SINGLE_SOURCE) {
+                bytes = n * sizeof(float);
+                float* d = static_cast<float*>(job.connection->reserve(bytes));
+                if (d) mesh.propagateInto(job.ids[0], d, workspace);
+                out = d;
+            } else if (r.type == QUERY_MULTI_SOURCE) {
+                mesh.distancesFromNearest(job.ids.data(), job.ids.size(), dist, pred);
+                bytes = n * sizeof(float);
+                out = job.connection->reserve(bytes);
+                if (out) memcpy(out, dist.data(), bytes);
+            } else if (r.type == QUERY_BOUNDED) {
+                mesh.distancesWithin(job.ids[0], r.radius, hits, workspace);
+                bytes = hits.size() * sizeof(QueryHit);
+                QueryHit* hit = static_cast<QueryHit*>(job.connection->reserve(bytes));
+                for (size_t i = 0; hit && i < hits.size(); ++i) {
+                    hit[i].vertex = hits[i].first;
+                    hit[i].distance = hits[i].second;
+                }
+                out = hit;
+            } else {
+                bytes = r.count * sizeof(float);
+                float* d = static_cast<float*>(job.connection->reserve(bytes));
+                for (size_t i = 0; d && i < r.count; ++i) {
+                    d[i] = mesh.distance(job.ids[2 * i], job.ids[2 * i + 1], workspace);
+                }
+                out = d;
+            }
+            finish(job, out ? QUERY_OK : QUERY_FAILED, bytes);
+        }
+    }
+
+    std::vector<std::shared_ptr<const DijkstraAlgorithm>> meshes;
+    std::vector<float> batchRadius;  // per mesh, 5% of its bounding box diagonal
+    int listenFd;
+    std::string socketPath;
+    int wakeFds[2];  // pipe that interrupts poll() when a connection is free again or on stop()
+    size_t numWorkers, maxBatch;
+    uint64_t nextConnection;
+    std::atomic<bool> stopping;
+
+    std::mutex mutex;  // guards jobs
+    std::condition_variable ready;
+    std::deque<Job> jobs;
+    Histogram latencies[QUERY_TYPES];
+};
+
+// Blocking client for QueryServer.
+class QueryClient {
+   public:
+    QueryClient() : fd(-1), shmName(), shm(nullptr), shmSize(0) {}
+
+    ~QueryClient() { disconnect(); }
+
+    bool connect(const std::string& path) {
+        disconnect();
+        sockaddr_un address;
+        if (path.size() >= sizeof(address.sun_path)) return false;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.c_str(), path.size());
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) return true;
+        disconnect();
+        return false;
+    }
+
+    void disconnect() {
+        if (shm) munmap(shm, shmSize);
+        shm = nullptr;
+        shmSize = 0;
+        shmName.clear();
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+
+    // Sends a request and waits for the reply. On QUERY_OK, data points to the payload of the given size, valid
+    // until the next query. Returns QUERY_FAILED if the connection or the shared memory fails.
+    QueryStatus query(QueryType type, uint32_t mesh, const uint32_t* ids, uint32_t count, float radius,
+                      const void*& data, size_t& bytes) {
+        QueryRequest request = {uint32_t(type), mesh, count, radius};
+        size_t idBytes = (type == QUERY_POINT_TO_POINT ? 2 : 1) * size_t(count) * sizeof(uint32_t);
+        QueryResponse response;
+        if (fd < 0 || send(fd, &request, sizeof(request), MSG_NOSIGNAL) != ssize_t(sizeof(request)) ||
+            (idBytes > 0 && send(fd, ids, idBytes, MSG_NOSIGNAL) != ssize_t(idBytes)) ||
+            recv(fd, &response, sizeof(response), MSG_WAITALL) != ssize_t(sizeof(response))) {
+            return QUERY_FAILED;
+        }
+        if (response.status != QUERY_OK) return QueryStatus(response.status);
+
+        response.shm[sizeof(response.shm) - 1] = '\0';
+        if (response.shm != shmName || response.bytes > shmSize) {
+            if (shm) munmap(shm, shmSize);
+            shm = nullptr;
+            shmSize = 0;
+            shmName = response.shm;
+            int shmFd = shm_open(shmName.c_str(), O_RDONLY, 0);
+            struct stat st;
+            if (shmFd >= 0 && fstat(shmFd, &st) == 0 && size_t(st.st_size) >= response.bytes && st.st_size > 0) {
+                void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, shmFd, 0);
+                if (mapped != MAP_FAILED) {
+                    shm = mapped;
+                    shmSize = st.st_size;
+                }
+            }
+            if (shmFd >= 0) close(shmFd);
+            if (!shm && response.bytes > 0) return QUERY_FAILED;
+        }
+        data = shm;
+        bytes = response.bytes;
+        return QUERY_OK;
+    }
+
+   private:
+    QueryClient(const QueryClient&);
+    QueryClient& operator=(const QueryClient&);
+
+    int fd;
+    std::string shmName;
+    void* shm;
+    size_t shmSize;
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "edge_graph.h"
+
+// Vertex orderings that place vertices which are close on the mesh close in memory. Every function returns order
+// with order[newId] = oldId.
+enum VertexOrder {
+    VERTEX_ORDER_NONE,
+    VERTEX_ORDER_MORTON,
+    VERTEX_ORDER_RCM,
+};
+
+inline bool parseVertexOrder(const std::string& name, VertexOrder& order) {
+    if (name == "none") {
+        order = VERTEX_ORDER_NONE;
+    } else if (name == "morton") {
+        order = VERTEX_ORDER_MORTON;
+    } else if (name == "rcm") {
+        order = VERTEX_ORDER_RCM;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Spreads the low 21 bits of x so that there are two zero bits between each.
+inline uint64_t mortonSpread(uint64_t x) {
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffull;
+    x = (x | x << 16) & 0x1f0000ff0000ffull;
+    x = (x | x << 8) & 0x100f00f00f00f00full;
+    x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+    x = (x | x << 2) & 0x1249249249249249ull;
+    return x;
+}
+
+// 63-bit Morton code of each position, quantized to 21 bits per axis within the bounding box.
+inline std::vector<uint64_t> mortonCodes(const glm::vec3* positions, size_t n) {
+    glm::vec3 bmin(std::numeric_limits<float>::max()), bmax(-std::numeric_limits<float>::max());
+    for (size_t i = 0; i < n; ++i) {
+        bmin = glm::min(bmin, positions[i]);
+        bmax = glm::max(bmax, positions[i]);
+    }
+    glm::vec3 extent = bmax - bmin;
+    float scale = float((1 << 21) - 1) / std::max(extent[0], std::max(extent[1], std::max(extent[2], 1e-30f)));
+
+    std::vector<uint64_t> codes(n);
+    for (size_t i = 0; i < n; ++i) {
+        glm::vec3 q = (positions[i] - bmin) * scale;
+        codes[i] = mortonSpread(uint64_t(q[0])) | mortonSpread(uint64_t(q[1])) << 1 | mortonSpread(uint64_t(q[2])) << 2;
+    }
+    return codes;
+}
+
+inline std::vector<uint32_t> mortonOrder(const glm::vec3* positions, size_t n) {
+    std::vector<uint64_t> codes = mortonCodes(positions, n);
+    std::vector<std::pair<uint64_t, uint32_t>> keys(n);
+    for (size_t i = 0; i < n; ++i) keys[i] = std::make_pair(codes[i], uint32_t(i));
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<uint32_t> order(n);
+    for (size_t i = 0; i < n; ++i) order[i] = keys[i].second;
+    return order;
+}
+
+// Reverse Cuthill-McKee: breadth-first search from a pseudo-peripheral vertex of every connected component,
+// visiting neighbors by increasing degree, then reversed. Keeps the bandwidth of the adjacency matrix small.
+inline std::vector<uint32_t> reverseCuthillMcKeeOrder(const EdgeGraph& graph) {
+    size_t n = graph.size();
+    std::vector<uint32_t> order;
+    order.reserve(n);
+    std::vector<char> visited(n, 0);
+    std::vector<uint32_t> level(n), neighbors;
+    auto degree = [&](uint32_t v) { return graph.offsets[v + 1] - graph.offsets[v]; };
+
+    // breadth-first search from root; returns the last vertex of the deepest level
+    auto farthest = [&](uint32_t root, std::vector<uint32_t>& visitedList) {
+        visitedList.assign(1, root);
+        level[root] = 0;
+        visited[root] = 1;
+        uint32_t best = root;
+        for (size_t i = 0; i < visitedList.size(); ++i) {
+            uint32_t u = visitedList[i];
+            if (level[u] > level[best] || (level[u] == level[best] && degree(u) < degree(best))) best = u;
+            for (uint32_t e = graph.offsets[u]; e < graph.offsets[u + 1]; ++e) {
+                uint32_t v = graph.neighbors[e];
+                if (visited[v]) continue;
+                visited[v] = 1;
+                level[v] = level[u] + 1;
+                visitedList.push_back(v);
+            }
+        }
+        for (size_t i = 0; i < visitedList.size(); ++i) visited[visitedList[i]] = 0;
+        return best;
+    };
+
+    std::vector<uint32_t> component;
+    for (uint32_t start = 0; start < n; ++start) {
+        if (visited[start]) continue;
+        uint32_t root = farthest(farthest(start, component), component);
+
+        size_t first = order.size();
+        order.push_back(root);
+        visited[root] = 1;
+        for (size_t i = first; i < order.size(); ++i) {
+            uint32_t u = order[i];
+            neighbors.clear();
+            for (uint32_t e = graph.offsets[u]; e < graph.offsets[u + 1]; ++e) {
+                if (!visited[graph.neighbors[e]]) neighbors.push_back(graph.neighbors[e]);
+            }
+            std::sort(neighbors.begin(), neighbors.end(),
+                      [&](uint32_t a, uint32_t b) { return degree(a) < degree(b) || (degree(a) == degree(b) && a < b); });
+            for (size_t k = 0; k < neighbors.size(); ++k) {
+                visited[neighbors[k]] = 1;
+                order.push_back(neighbors[k]);
+            }
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
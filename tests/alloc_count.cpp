@@ -0,0 +1,87 @@
+// Checks that queries through a reused workspace or output buffer allocate nothing once warmed up. Every global
+// operator new is counted; each sequence of queries runs once to grow the storage it needs, then again counted.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "distance_dijkstra.h"
+#include "distance_reordered.h"
+
+static std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size) {
+    ++allocations;
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+// Kept out of line, or GCC takes the free inlined into a delete for a mismatch with the builtin new.
+__attribute__((noinline)) static void release(void* p) { std::free(p); }
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
+
+// Bumpy grid of size x size vertices, two triangles per cell.
+static std::shared_ptr<const Mesh> grid(int size) {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) positions.push_back(glm::vec3(x, y, float((x * 7 + y * 13) % 5) * 0.1f));
+    }
+    for (int y = 0; y + 1 < size; ++y) {
+        for (int x = 0; x + 1 < size; ++x) {
+            uint32_t a = y * size + x;
+            uint32_t face[6] = {a, a + 1, a + size, a + 1, a + size + 1, a + size};
+            indices.insert(indices.end(), face, face + 6);
+        }
+    }
+    return std::make_shared<const Mesh>(std::move(positions), std::move(indices));
+}
+
+static int failures = 0;
+
+// Runs query(i) for i = 0 .. repeats - 1 twice and expects no allocation the second time.
+template <typename Query>
+static void expectNoAllocations(const char* name, Query query, int repeats = 20) {
+    for (int i = 0; i < repeats; ++i) query(i);
+    size_t before = allocations;
+    for (int i = 0; i < repeats; ++i) query(i);
+    size_t count = allocations - before;
+    printf("%s: %zu allocations in %d queries\n", name, count, repeats);
+    if (count != 0) ++failures;
+}
+
+int main() {
+    const int size = 100;
+    std::shared_ptr<const Mesh> mesh = grid(size);
+    size_t n = mesh->numVertices();
+    std::vector<float> out(n);
+
+    DijkstraAlgorithm dijkstra;
+    dijkstra.load(mesh);
+    DijkstraAlgorithm::Workspace ws;
+    expectNoAllocations("propagateInto with workspace",
+                        [&](int i) { dijkstra.propagateInto(uint32_t(i * 37 % n), out.data(), ws); });
+    expectNoAllocations("propagateInto", [&](int i) { dijkstra.propagateInto(i * 37 % n, out.data()); });
+
+    std::vector<std::pair<uint32_t, float>> within;
+    within.reserve(n);
+    expectNoAllocations("distancesWithin", [&](int i) { dijkstra.distancesWithin(i * 37 % n, 10.f, within, ws); });
+    expectNoAllocations("distance", [&](int i) { dijkstra.distance(i * 37 % n, n - 1 - i * 11 % n, ws); });
+
+    ReorderedAlgorithm reordered(new DijkstraAlgorithm(), VERTEX_ORDER_RCM);
+    reordered.load(mesh);
+    expectNoAllocations("reordered propagateInto", [&](int i) { reordered.propagateInto(i * 37 % n, out.data()); });
+
+    if (failures) printf("%d queries allocated\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+// Checks that delta-stepping returns exactly the distances of Dijkstra: on bumpy grids from many sources, and on
+// chains whose links are within a few ulps of delta, where float rounding often files a vertex reached over a heavy
+// edge back into the bucket being processed.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "distance_delta_stepping.h"
+#include "distance_dijkstra.h"
+
+// Bumpy grid of size x size vertices, two triangles per cell.
+static std::shared_ptr<const Mesh> grid(int size) {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) positions.push_back(glm::vec3(x, y, float((x * 7 + y * 13) % 5) * 0.1f));
+    }
+    for (int y = 0; y + 1 < size; ++y) {
+        for (int x = 0; x + 1 < size; ++x) {
+            uint32_t a = y * size + x;
+            uint32_t face[6] = {a, a + 1, a + size, a + 1, a + size + 1, a + size};
+            indices.insert(indices.end(), face, face + 6);
+        }
+    }
+    return std::make_shared<const Mesh>(std::move(positions), std::move(indices));
+}
+
+// Chain of n vertices whose links are unit long plus zero to two ulps, so the median and delta for a scale of 1 is
+// within two ulps of every link.
+static std::shared_ptr<const Mesh> chain(size_t n, float unit, std::mt19937& rng) {
+    std::vector<std::vector<std::pair<uint32_t, float>>> rows(n);
+    for (uint32_t u = 0; u + 1 < n; ++u) {
+        float w = unit;
+        for (unsigned k = rng() % 3; k > 0; --k) w = std::nextafter(w, 2.f * unit);
+        rows[u].push_back(std::make_pair(u + 1, w));
+        rows[u + 1].push_back(std::make_pair(u, w));
+    }
+
+    EdgeGraph graph;
+    graph.offsets.push_back(0);
+    for (size_t u = 0; u < n; ++u) {
+        std::sort(rows[u].begin(), rows[u].end());
+        for (size_t i = 0; i < rows[u].size(); ++i) {
+            graph.neighbors.push_back(rows[u][i].first);
+            graph.weights.push_back(rows[u][i].second);
+        }
+        graph.offsets.push_back(uint32_t(graph.neighbors.size()));
+    }
+    return std::make_shared<const Mesh>(std::vector<glm::vec3>(n), std::vector<uint32_t>(), std::move(graph));
+}
+
+static int failures = 0;
+
+// Compares both algorithms from the given sources, bit for bit.
+static void expectSame(const char* name, std::shared_ptr<const Mesh> mesh, float deltaScale,
+                       const std::vector<int>& sources) {
+    DijkstraAlgorithm dijkstra;
+    dijkstra.load(mesh);
+    DeltaSteppingAlgorithm deltaStepping(deltaScale);
+    deltaStepping.load(mesh);
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        std::vector<float> expected = dijkstra.propagate(sources[i]);
+        std::vector<float> actual = deltaStepping.propagate(sources[i]);
+        for (size_t v = 0; v < expected.size(); ++v) {
+            if (actual[v] != expected[v]) ++mismatches;
+        }
+    }
+    printf("%s: %zu mismatches from %zu sources\n", name, mismatches, sources.size());
+    if (mismatches) ++failures;
+}
+
+int main() {
+    std::mt19937 rng(1);
+
+    std::shared_ptr<const Mesh> mesh = grid(60);
+    std::vector<int> sources;
+    for (int i = 0; i < 50; ++i) sources.push_back(int(rng() % mesh->numVertices()));
+    expectSame("grid, delta scale 1", mesh, 1.f, sources);
+    expectSame("grid, delta scale 4", mesh, 4.f, sources);
+
+    const float units[3] = {0.1f, 1.f / 3.f, 7.3f};
+    for (int i = 0; i < 3; ++i) {
+        mesh = chain(2000, units[i], rng);
+        sources.clear();
+        for (int k = 0; k < 20; ++k) sources.push_back(int(rng() % mesh->numVertices()));
+        char name[64];
+        snprintf(name, sizeof(name), "chain, unit %g", units[i]);
+        expectSame(name, mesh, 1.f, sources);
+    }
+
+    if (failures) printf("%d cases differ from Dijkstra\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
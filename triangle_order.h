@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Average cache miss ratio (vertex shader invocations per triangle) of a FIFO post-transform cache.
+inline float averageCacheMissRatio(const uint32_t* indices, size_t numFaces, size_t numVertices, size_t cacheSize) {
+    if (numFaces == 0) return 0.f;
+    std::vector<size_t> insertedAt(numVertices, 0);  // 1 + FIFO position at insertion, 0 if never cached
+    size_t misses = 0;
+    for (size_t i = 0; i < 3 * numFaces; ++i) {
+        size_t& t = insertedAt[indices[i]];
+        if (t == 0 || misses + 1 - t > cacheSize) {
+            ++misses;
+            t = misses;
+        }
+    }
+    return float(misses) / numFaces;
+}
+
+// Tipsify (Sander et al. 2007): fans around a vertex at a time and picks the next fanning vertex among those still
+// in the simulated FIFO cache, giving near-optimal vertex reuse in linear time. Whenever the cache has to be
+// restarted a new cluster begins; clusters are then sorted so that those facing away from the mesh centroid come
+// first, which tends to draw occluders before what they hide and reduces overdraw.
+//
+// Returns the new face order as old face ids.
+inline std::vector<uint32_t> optimizeTriangleOrder(const uint32_t* indices, size_t numFaces, const glm::vec3* positions,
+                                                   size_t numVertices, size_t cacheSize = 16) {
+    // vertex -> faces adjacency
+    std::vector<uint32_t> offsets(numVertices + 1, 0), adjacent(3 * numFaces);
+    for (size_t i = 0; i < 3 * numFaces; ++i) ++offsets[indices[i] + 1];
+    for (size_t v = 0; v < numVertices; ++v) offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> live(numVertices);
+    for (size_t v = 0; v < numVertices; ++v) live[v] = offsets[v + 1] - offsets[v];
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < 3 * numFaces; ++i) adjacent[fill[indices[i]]++] = i / 3;
+    }
+
+    std::vector<uint32_t> order;
+    order.reserve(numFaces);
+    std::vector<size_t> clusterStarts;
+    std::vector<size_t> cacheTime(numVertices, 0);
+    std::vector<char> emitted(numFaces, 0);
+    std::vector<uint32_t> deadEnd, candidates;
+    size_t time = cacheSize + 1;
+    size_t cursor = 0;
+
+    int fan = numVertices > 0 ? 0 : -1;
+    bool restarted = true;
+    while (fan >= 0) {
+        if (restarted) clusterStarts.push_back(order.size());
+        candidates.clear();
+        for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; ++a) {
+            uint32_t f = adjacent[a];
+            if (emitted[f]) continue;
+            emitted[f] = 1;
+            order.push_back(f);
+            for (int k = 0; k < 3; ++k) {
+                uint32_t v = indices[3 * f + k];
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - cacheTime[v] > cacheSize) cacheTime[v] = time++;
+            }
+        }
+
+        // prefer the candidate that entered the cache earliest but will not be evicted before its fan is done
+        int best = -1;
+        size_t bestPriority = 0;
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            uint32_t v = candidates[i];
+            if (live[v] == 0) continue;
+            size_t age = time - cacheTime[v];
+            size_t priority = age + 2 * live[v] <= cacheSize ? age : 0;
+            if (best < 0 || priority > bestPriority) {
+                best = v;
+                bestPriority = priority;
+            }
+        }
+
+        restarted = best < 0;
+        if (restarted) {
+            while (!deadEnd.empty() && best < 0) {
+                if (live[deadEnd.back()] > 0) best = deadEnd.back();
+                deadEnd.pop_back();
+            }
+            while (best < 0 && cursor < numVertices) {
+                if (live[cursor] > 0) best = cursor;
+                ++cursor;
+            }
+        }
+        fan = best;
+    }
+    clusterStarts.push_back(order.size());
+
+    // overdraw: sort clusters by how much they face away from the centroid
+    glm::vec3 centroid(0.f);
+    for (size_t v = 0; v < numVertices; ++v) centroid += positions[v];
+    if (numVertices > 0) centroid /= float(numVertices);
+
+    size_t numClusters = clusterStarts.size() - 1;
+    std::vector<std::pair<float, size_t>> clusters(numClusters);
+    for (size_t c = 0; c < numClusters; ++c) {
+        glm::vec3 center(0.f), normal(0.f);
+        float area = 0.f;
+        for (size_t i = clusterStarts[c]; i < clusterStarts[c + 1]; ++i) {
+            const uint32_t* t = indices + 3 * order[i];
+            glm::vec3 n = glm::cross(positions[t[1]] - positions[t[0]], positions[t[2]] - positions[t[0]]);
+            float a = glm::length(n);
+            center += a * (positions[t[0]] + positions[t[1]] + positions[t[2]]) / 3.f;
+            normal += n;
+            area += a;
+        }
+        if (area > 0.f) center /= area;
+        float l = glm::length(normal);
+        clusters[c] = std::make_pair(l > 0.f ? -glm::dot(center - centroid, normal / l) : 0.f, c);
+    }
+    std::stable_sort(clusters.begin(), clusters.end());
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(numFaces);
+    for (size_t c = 0; c < numClusters; ++c) {
+        size_t k = clusters[c].second;
+        sorted.insert(sorted.end(), order.begin() + clusterStarts[k], order.begin() + clusterStarts[k + 1]);
+    }
+    return sorted;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.h"
+#include "parallel.h"
+
+struct WeldStats {
+    size_t duplicates;    // vertices merged into another one
+    size_t droppedFaces;  // faces with a corner out of range or repeated after welding
+};
+
+// Merges vertices closer than epsilon, such as the copies OBJ exporters write along UV and normal seams, which
+// would otherwise cut the edge graph there. Vertices are hashed into a grid of cells several times epsilon wide;
+// then, in parallel over blocks of vertices, each one looks for the lowest numbered vertex within epsilon in its own
+// cell and in those of the 26 around it that it is within epsilon of, and joins whatever that vertex joined. A
+// welded vertex keeps the position of the lowest numbered vertex of its group. Faces left with a repeated corner are
+// dropped, as are faces referring to vertices that do not exist.
+//
+// remap[v] is the vertex of the returned mesh that input vertex v became, so results on the welded mesh can be
+// reported per original vertex.
+inline std::shared_ptr<const Mesh> weldVertices(const Mesh& mesh, float epsilon, std::vector<uint32_t>& remap,
+                                                WeldStats* stats = nullptr) {
+    const std::vector<glm::vec3>& p = mesh.positions();
+    const size_t n = p.size();
+    const glm::vec3 lo = mesh.boundsMin();
+    epsilon = std::max(epsilon, 0.f);
+    // most vertices are then far enough from the cell walls to need only their own cell; cells no finer than a ten
+    // millionth of the bounding box keep the cell coordinates in range
+    float cellSize = std::max(8.f * epsilon, 1e-7f * glm::length(mesh.boundsMax() - lo));
+    if (!(cellSize > 0.f)) cellSize = 1.f;
+
+    size_t tableSize = 1;
+    while (tableSize < n) tableSize *= 2;
+    const size_t mask = tableSize - 1;
+    // cell coordinates are often multiples of a common grid step, so the bits are mixed before masking
+    auto bucket = [mask](int32_t x, int32_t y, int32_t z) {
+        uint32_t h = uint32_t(x) * 0x9e3779b1u ^ uint32_t(y) * 0x85ebca77u ^ uint32_t(z) * 0xc2b2ae3du;
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return h & mask;
+    };
+
+    std::vector<int32_t> cells(3 * n);
+    std::vector<uint32_t> buckets(n);
+    parallelFor(n, 4096, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            for (int k = 0; k < 3; ++k) cells[3 * v + k] = int32_t(std::floor((p[v][k] - lo[k]) / cellSize));
+            buckets[v] = bucket(cells[3 * v], cells[3 * v + 1], cells[3 * v + 2]);
+        }
+    });
+
+    // bucket b holds [bucketOffsets[b], bucketOffsets[b + 1]) of entries, by increasing vertex; the cell is stored
+    // next to the vertex so that a probe touches one cache line
+    struct Entry {
+        int32_t x, y, z;
+        uint32_t v;
+    };
+    std::vector<uint32_t> bucketOffsets(tableSize + 1, 0);
+    std::vector<Entry> entries(n);
+    for (size_t v = 0; v < n; ++v) ++bucketOffsets[buckets[v] + 1];
+    for (size_t b = 0; b < tableSize; ++b) bucketOffsets[b + 1] += bucketOffsets[b];
+    {
+        std::vector<uint32_t> fill(bucketOffsets.begin(), bucketOffsets.end() - 1);
+        for (size_t v = 0; v < n; ++v) {
+            Entry e = {cells[3 * v], cells[3 * v + 1], cells[3 * v + 2], uint32_t(v)};
+            entries[fill[buckets[v]]++] = e;
+        }
+    }
+
+    // representative[v] <= v is the lowest numbered vertex within epsilon of v
+    std::vector<uint32_t> representative(n);
+    const float epsilon2 = epsilon * epsilon;
+    parallelFor(n, 4096, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            uint32_t best = v;
+            const int32_t* c = &cells[3 * v];
+            // neighboring cells per axis that may hold a vertex within epsilon, with some slack for rounding
+            int32_t first[3], last[3];
+            for (int k = 0; k < 3; ++k) {
+                float offset = p[v][k] - lo[k] - c[k] * cellSize;
+                first[k] = offset <= 1.01f * epsilon + 1e-6f * cellSize ? -1 : 0;
+                last[k] = cellSize - offset <= 1.01f * epsilon + 1e-6f * cellSize ? 1 : 0;
+            }
+            for (int32_t dx = first[0]; dx <= last[0]; ++dx) {
+                for (int32_t dy = first[1]; dy <= last[1]; ++dy) {
+                    for (int32_t dz = first[2]; dz <= last[2]; ++dz) {
+                        int32_t x = c[0] + dx, y = c[1] + dy, z = c[2] + dz;
+                        uint32_t b = bucket(x, y, z);
+                        for (uint32_t i = bucketOffsets[b]; i < bucketOffsets[b + 1]; ++i) {
+                            const Entry& e = entries[i];
+                            if (e.v >= best) break;
+                            if (e.x != x || e.y != y || e.z != z) continue;
+                            glm::vec3 d = p[e.v] - p[v];
+                            if (glm::dot(d, d) <= epsilon2) {
+                                best = e.v;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+            representative[v] = best;
+        }
+    });
+
+    // representatives are numbered before the vertices that joined them, so one pass resolves chains
+    remap.resize(n);
+    std::vector<glm::vec3> positions;
+    for (size_t v = 0; v < n; ++v) {
+        if (representative[v] == v) {
+            remap[v] = positions.size();
+            positions.push_back(p[v]);
+        } else {
+            remap[v] = remap[representative[v]];
+        }
+    }
+
+    const std::vector<uint32_t>& faces = mesh.indices();
+    std::vector<uint32_t> indices;
+    indices.reserve(faces.size());
+    for (size_t f = 0; f < faces.size() / 3; ++f) {
+        if (std::max(faces[3 * f], std::max(faces[3 * f + 1], faces[3 * f + 2])) >= n) continue;
+        uint32_t a = remap[faces[3 * f]], b = remap[faces[3 * f + 1]], c = remap[faces[3 * f + 2]];
+        if (a == b || b == c || c == a) continue;
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(c);
+    }
+
+    if (stats) {
+        stats->duplicates = n - positions.size();
+        stats->droppedFaces = (faces.size() - indices.size()) / 3;
+    }
+    return std::make_shared<const Mesh>(std::move(positions), std::move(indices));
+}